@@ -10,8 +10,34 @@
 #define FONT_NORMAL	0x00
 #define FONT_INVERSE	0x01
 #define FONT_UNDERLINE	0x02
+#define FONT_BOLD	0x04 // drawn as underline, there is no bold face
 
+// Fonts for font_select()
+#define FONT_6X8	0 // 40x8 characters
+#define FONT_4X6	1 // 60x10 characters
+#define FONT_COUNT	2
 
+// Smallest character cell, for sizing the text buffers
+#define FONT_MIN_WIDTH	4
+#define FONT_MIN_HEIGHT	6
+
+/** Pixels per character cell in the current font */
+extern uint8_t font_width;
+extern uint8_t font_height;
+
+
+/** Switch to one of the fonts.
+ *
+ * Nothing on the display is changed; the caller has to redraw it
+ * in the new character cells.
+ */
+extern void
+font_select(
+	uint8_t font
+);
+
+
+/** Draw one character, in the cell at col,row of the current font */
 extern void
 font_draw(
 	uint8_t col,
@@ -21,4 +47,18 @@ font_draw(
 );
 
 
+/** Draw n characters with the same attributes along a row.
+ *
+ * If s is NULL the cells are blanked instead.
+ */
+extern void
+font_draw_run(
+	uint8_t col,
+	uint8_t row,
+	const char * s,
+	uint8_t n,
+	uint8_t mod
+);
+
+
 #endif
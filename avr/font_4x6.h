@@ -0,0 +1,146 @@
+/** \file
+ * 4x6 font, generated by fonts/mkfont.py from fonts/4x6.txt.
+ * Do not edit; change the source bitmap and run "make fonts".
+ */
+#define FONT_4X6_WIDTH	4
+#define FONT_4X6_HEIGHT	6
+#define FONT_4X6_FIRST	0x20
+#ifdef CONFIG_FONT_8BIT
+#define FONT_4X6_LAST	0x9F
+#else
+#define FONT_4X6_LAST	0x7E
+#endif
+
+static const uint8_t font_4x6[][4] PROGMEM =
+{
+	{0x00,0x00,0x00,0x00}, // 0x20 ' '
+	{0x00,0x00,0x17,0x00}, // 0x21 '!'
+	{0x00,0x03,0x00,0x03}, // 0x22 '"'
+	{0x00,0x1F,0x0A,0x1F}, // 0x23 '#'
+	{0x00,0x12,0x1F,0x09}, // 0x24 '$'
+	{0x00,0x19,0x04,0x13}, // 0x25 '%'
+	{0x00,0x0A,0x15,0x1A}, // 0x26 '&'
+	{0x00,0x00,0x03,0x00}, // 0x27 "'"
+	{0x00,0x00,0x0E,0x11}, // 0x28 '('
+	{0x00,0x11,0x0E,0x00}, // 0x29 ')'
+	{0x00,0x0A,0x04,0x0A}, // 0x2A '*'
+	{0x00,0x04,0x0E,0x04}, // 0x2B '+'
+	{0x00,0x10,0x08,0x00}, // 0x2C ','
+	{0x00,0x04,0x04,0x04}, // 0x2D '-'
+	{0x00,0x00,0x10,0x00}, // 0x2E '.'
+	{0x00,0x18,0x04,0x03}, // 0x2F '/'
+	{0x00,0x1E,0x11,0x0F}, // 0x30 '0'
+	{0x00,0x02,0x1F,0x00}, // 0x31 '1'
+	{0x00,0x19,0x15,0x12}, // 0x32 '2'
+	{0x00,0x11,0x15,0x0A}, // 0x33 '3'
+	{0x00,0x07,0x04,0x1F}, // 0x34 '4'
+	{0x00,0x17,0x15,0x09}, // 0x35 '5'
+	{0x00,0x1E,0x15,0x1D}, // 0x36 '6'
+	{0x00,0x19,0x05,0x03}, // 0x37 '7'
+	{0x00,0x1F,0x15,0x1F}, // 0x38 '8'
+	{0x00,0x17,0x15,0x0F}, // 0x39 '9'
+	{0x00,0x00,0x0A,0x00}, // 0x3A ':'
+	{0x00,0x10,0x0A,0x00}, // 0x3B ';'
+	{0x00,0x04,0x0A,0x11}, // 0x3C '<'
+	{0x00,0x0A,0x0A,0x0A}, // 0x3D '='
+	{0x00,0x11,0x0A,0x04}, // 0x3E '>'
+	{0x00,0x01,0x15,0x03}, // 0x3F '?'
+	{0x00,0x0E,0x15,0x16}, // 0x40 '@'
+	{0x00,0x1E,0x05,0x1E}, // 0x41 'A'
+	{0x00,0x1F,0x15,0x0A}, // 0x42 'B'
+	{0x00,0x0E,0x11,0x11}, // 0x43 'C'
+	{0x00,0x1F,0x11,0x0E}, // 0x44 'D'
+	{0x00,0x1F,0x15,0x15}, // 0x45 'E'
+	{0x00,0x1F,0x05,0x05}, // 0x46 'F'
+	{0x00,0x0E,0x11,0x1D}, // 0x47 'G'
+	{0x00,0x1F,0x04,0x1F}, // 0x48 'H'
+	{0x00,0x11,0x1F,0x11}, // 0x49 'I'
+	{0x00,0x08,0x10,0x0F}, // 0x4A 'J'
+	{0x00,0x1F,0x04,0x1B}, // 0x4B 'K'
+	{0x00,0x1F,0x10,0x10}, // 0x4C 'L'
+	{0x00,0x1F,0x06,0x1F}, // 0x4D 'M'
+	{0x00,0x1F,0x0E,0x1F}, // 0x4E 'N'
+	{0x00,0x0E,0x11,0x0E}, // 0x4F 'O'
+	{0x00,0x1F,0x05,0x02}, // 0x50 'P'
+	{0x00,0x0E,0x19,0x1E}, // 0x51 'Q'
+	{0x00,0x1F,0x0D,0x16}, // 0x52 'R'
+	{0x00,0x12,0x15,0x09}, // 0x53 'S'
+	{0x00,0x01,0x1F,0x01}, // 0x54 'T'
+	{0x00,0x0F,0x10,0x1F}, // 0x55 'U'
+	{0x00,0x07,0x18,0x07}, // 0x56 'V'
+	{0x00,0x1F,0x0C,0x1F}, // 0x57 'W'
+	{0x00,0x1B,0x04,0x1B}, // 0x58 'X'
+	{0x00,0x03,0x1C,0x03}, // 0x59 'Y'
+	{0x00,0x19,0x15,0x13}, // 0x5A 'Z'
+	{0x00,0x1F,0x11,0x11}, // 0x5B '['
+	{0x00,0x03,0x04,0x18}, // 0x5C '\\'
+	{0x00,0x11,0x11,0x1F}, // 0x5D ']'
+	{0x00,0x02,0x01,0x02}, // 0x5E '^'
+	{0x00,0x10,0x10,0x10}, // 0x5F '_'
+	{0x00,0x01,0x02,0x00}, // 0x60 '`'
+	{0x00,0x1A,0x16,0x1C}, // 0x61 'a'
+	{0x00,0x1F,0x12,0x0C}, // 0x62 'b'
+	{0x00,0x0C,0x12,0x12}, // 0x63 'c'
+	{0x00,0x0C,0x12,0x1F}, // 0x64 'd'
+	{0x00,0x0C,0x1A,0x16}, // 0x65 'e'
+	{0x00,0x04,0x1E,0x05}, // 0x66 'f'
+	{0x00,0x0C,0x0A,0x1E}, // 0x67 'g'
+	{0x00,0x1F,0x02,0x1C}, // 0x68 'h'
+	{0x00,0x14,0x1D,0x10}, // 0x69 'i'
+	{0x00,0x08,0x10,0x0D}, // 0x6A 'j'
+	{0x00,0x1F,0x0C,0x12}, // 0x6B 'k'
+	{0x00,0x11,0x1F,0x10}, // 0x6C 'l'
+	{0x00,0x1E,0x0E,0x1E}, // 0x6D 'm'
+	{0x00,0x1E,0x02,0x1C}, // 0x6E 'n'
+	{0x00,0x0C,0x12,0x0C}, // 0x6F 'o'
+	{0x00,0x1E,0x0A,0x04}, // 0x70 'p'
+	{0x00,0x04,0x0A,0x1E}, // 0x71 'q'
+	{0x00,0x1C,0x02,0x02}, // 0x72 'r'
+	{0x00,0x14,0x1E,0x0A}, // 0x73 's'
+	{0x00,0x02,0x1F,0x12}, // 0x74 't'
+	{0x00,0x0E,0x10,0x1E}, // 0x75 'u'
+	{0x00,0x06,0x18,0x06}, // 0x76 'v'
+	{0x00,0x1E,0x1C,0x1E}, // 0x77 'w'
+	{0x00,0x12,0x0C,0x12}, // 0x78 'x'
+	{0x00,0x16,0x18,0x0E}, // 0x79 'y'
+	{0x00,0x1A,0x1E,0x16}, // 0x7A 'z'
+	{0x00,0x04,0x1F,0x11}, // 0x7B '{'
+	{0x00,0x00,0x1F,0x00}, // 0x7C '|'
+	{0x00,0x11,0x1F,0x04}, // 0x7D '}'
+	{0x00,0x02,0x03,0x01}, // 0x7E '~'
+#ifdef CONFIG_FONT_8BIT
+	{0x00,0x00,0x00,0x00}, // 0x7F unused
+	{0x00,0x00,0x00,0x00}, // 0x80 blank
+	{0x00,0x04,0x0E,0x04}, // 0x81 diamond
+	{0x2A,0x15,0x2A,0x15}, // 0x82 checkerboard
+	{0x00,0x07,0x1A,0x07}, // 0x83 HT
+	{0x00,0x07,0x1D,0x14}, // 0x84 FF
+	{0x00,0x1A,0x0D,0x15}, // 0x85 CR
+	{0x00,0x07,0x1C,0x0C}, // 0x86 LF
+	{0x00,0x02,0x05,0x02}, // 0x87 degree
+	{0x00,0x12,0x17,0x12}, // 0x88 plus/minus
+	{0x00,0x1F,0x12,0x17}, // 0x89 NL
+	{0x00,0x0B,0x1C,0x0B}, // 0x8A VT
+	{0x04,0x04,0x07,0x00}, // 0x8B lower right corner
+	{0x04,0x04,0x3C,0x00}, // 0x8C upper right corner
+	{0x00,0x00,0x3C,0x04}, // 0x8D upper left corner
+	{0x00,0x00,0x07,0x04}, // 0x8E lower left corner
+	{0x04,0x04,0x3F,0x04}, // 0x8F crossing lines
+	{0x01,0x01,0x01,0x01}, // 0x90 scan line 1
+	{0x02,0x02,0x02,0x02}, // 0x91 scan line 3
+	{0x04,0x04,0x04,0x04}, // 0x92 scan line 5, horizontal line
+	{0x10,0x10,0x10,0x10}, // 0x93 scan line 7
+	{0x20,0x20,0x20,0x20}, // 0x94 scan line 9
+	{0x00,0x00,0x3F,0x04}, // 0x95 left tee
+	{0x04,0x04,0x3F,0x00}, // 0x96 right tee
+	{0x04,0x04,0x07,0x04}, // 0x97 bottom tee
+	{0x04,0x04,0x3C,0x04}, // 0x98 top tee
+	{0x00,0x00,0x3F,0x00}, // 0x99 vertical line
+	{0x00,0x10,0x12,0x15}, // 0x9A less than or equal
+	{0x00,0x15,0x12,0x10}, // 0x9B greater than or equal
+	{0x00,0x1E,0x02,0x1E}, // 0x9C pi
+	{0x00,0x1A,0x0E,0x0B}, // 0x9D not equal
+	{0x00,0x14,0x1F,0x15}, // 0x9E pound sterling
+	{0x00,0x00,0x04,0x00}, // 0x9F centered dot
+#endif
+};
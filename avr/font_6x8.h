@@ -0,0 +1,146 @@
+/** \file
+ * 6x8 font, generated by fonts/mkfont.py from fonts/6x8.txt.
+ * Do not edit; change the source bitmap and run "make fonts".
+ */
+#define FONT_6X8_WIDTH	6
+#define FONT_6X8_HEIGHT	8
+#define FONT_6X8_FIRST	0x20
+#ifdef CONFIG_FONT_8BIT
+#define FONT_6X8_LAST	0x9F
+#else
+#define FONT_6X8_LAST	0x7E
+#endif
+
+static const uint8_t font_6x8[][6] PROGMEM =
+{
+	{0x00,0x00,0x00,0x00,0x00,0x00}, // 0x20 ' '
+	{0x00,0x00,0x00,0x4F,0x00,0x00}, // 0x21 '!'
+	{0x00,0x00,0x07,0x00,0x07,0x00}, // 0x22 '"'
+	{0x00,0x14,0x7F,0x14,0x7F,0x14}, // 0x23 '#'
+	{0x00,0x24,0x2A,0x7F,0x2A,0x12}, // 0x24 '$'
+	{0x00,0x23,0x13,0x08,0x64,0x62}, // 0x25 '%'
+	{0x00,0x36,0x49,0x55,0x22,0x50}, // 0x26 '&'
+	{0x00,0x00,0x05,0x03,0x00,0x00}, // 0x27 "'"
+	{0x00,0x00,0x1C,0x22,0x41,0x00}, // 0x28 '('
+	{0x00,0x00,0x41,0x22,0x1C,0x00}, // 0x29 ')'
+	{0x00,0x14,0x08,0x3E,0x08,0x14}, // 0x2A '*'
+	{0x00,0x08,0x08,0x3E,0x08,0x08}, // 0x2B '+'
+	{0x00,0x00,0x50,0x30,0x00,0x00}, // 0x2C ','
+	{0x00,0x08,0x08,0x08,0x08,0x08}, // 0x2D '-'
+	{0x00,0x00,0x60,0x60,0x00,0x00}, // 0x2E '.'
+	{0x00,0x20,0x10,0x08,0x04,0x02}, // 0x2F '/'
+	{0x00,0x3E,0x51,0x49,0x45,0x3E}, // 0x30 '0'
+	{0x00,0x00,0x42,0x7F,0x40,0x00}, // 0x31 '1'
+	{0x00,0x42,0x61,0x51,0x49,0x46}, // 0x32 '2'
+	{0x00,0x21,0x41,0x45,0x4B,0x31}, // 0x33 '3'
+	{0x00,0x18,0x14,0x12,0x7F,0x10}, // 0x34 '4'
+	{0x00,0x27,0x45,0x45,0x45,0x39}, // 0x35 '5'
+	{0x00,0x3C,0x4A,0x49,0x49,0x30}, // 0x36 '6'
+	{0x00,0x01,0x71,0x09,0x05,0x03}, // 0x37 '7'
+	{0x00,0x36,0x49,0x49,0x49,0x36}, // 0x38 '8'
+	{0x00,0x06,0x49,0x49,0x29,0x1E}, // 0x39 '9'
+	{0x00,0x36,0x36,0x00,0x00,0x00}, // 0x3A ':'
+	{0x00,0x56,0x36,0x00,0x00,0x00}, // 0x3B ';'
+	{0x00,0x08,0x14,0x22,0x41,0x00}, // 0x3C '<'
+	{0x00,0x14,0x14,0x14,0x14,0x14}, // 0x3D '='
+	{0x00,0x00,0x41,0x22,0x14,0x08}, // 0x3E '>'
+	{0x00,0x02,0x01,0x51,0x09,0x06}, // 0x3F '?'
+	{0x00,0x30,0x49,0x79,0x41,0x3E}, // 0x40 '@'
+	{0x00,0x7E,0x11,0x11,0x11,0x7E}, // 0x41 'A'
+	{0x00,0x7F,0x49,0x49,0x49,0x36}, // 0x42 'B'
+	{0x00,0x3E,0x41,0x41,0x41,0x22}, // 0x43 'C'
+	{0x00,0x7F,0x41,0x41,0x22,0x1C}, // 0x44 'D'
+	{0x00,0x7F,0x49,0x49,0x49,0x41}, // 0x45 'E'
+	{0x00,0x7F,0x09,0x09,0x09,0x01}, // 0x46 'F'
+	{0x00,0x3E,0x41,0x49,0x49,0x7A}, // 0x47 'G'
+	{0x00,0x7F,0x08,0x08,0x08,0x7F}, // 0x48 'H'
+	{0x00,0x00,0x41,0x7F,0x41,0x00}, // 0x49 'I'
+	{0x00,0x20,0x40,0x41,0x3F,0x01}, // 0x4A 'J'
+	{0x00,0x7F,0x08,0x14,0x22,0x41}, // 0x4B 'K'
+	{0x00,0x7F,0x40,0x40,0x40,0x40}, // 0x4C 'L'
+	{0x00,0x7F,0x02,0x0C,0x02,0x7F}, // 0x4D 'M'
+	{0x00,0x7F,0x04,0x08,0x10,0x7F}, // 0x4E 'N'
+	{0x00,0x3E,0x41,0x41,0x41,0x3E}, // 0x4F 'O'
+	{0x00,0x7F,0x09,0x09,0x09,0x06}, // 0x50 'P'
+	{0x00,0x3E,0x41,0x51,0x21,0x5E}, // 0x51 'Q'
+	{0x00,0x7F,0x09,0x19,0x29,0x46}, // 0x52 'R'
+	{0x00,0x46,0x49,0x49,0x49,0x31}, // 0x53 'S'
+	{0x00,0x01,0x01,0x7F,0x01,0x01}, // 0x54 'T'
+	{0x00,0x3F,0x40,0x40,0x40,0x3F}, // 0x55 'U'
+	{0x00,0x1F,0x20,0x40,0x20,0x1F}, // 0x56 'V'
+	{0x00,0x3F,0x40,0x30,0x40,0x3F}, // 0x57 'W'
+	{0x00,0x63,0x14,0x08,0x14,0x63}, // 0x58 'X'
+	{0x00,0x07,0x08,0x70,0x08,0x07}, // 0x59 'Y'
+	{0x00,0x61,0x51,0x49,0x45,0x43}, // 0x5A 'Z'
+	{0x00,0x00,0x7F,0x41,0x41,0x00}, // 0x5B '['
+	{0x00,0x02,0x04,0x08,0x10,0x20}, // 0x5C '\\'
+	{0x00,0x00,0x41,0x41,0x7F,0x00}, // 0x5D ']'
+	{0x00,0x04,0x02,0x01,0x02,0x04}, // 0x5E '^'
+	{0x00,0x40,0x40,0x40,0x40,0x40}, // 0x5F '_'
+	{0x00,0x00,0x01,0x02,0x04,0x00}, // 0x60 '`'
+	{0x00,0x20,0x54,0x54,0x54,0x78}, // 0x61 'a'
+	{0x00,0x7F,0x50,0x48,0x48,0x30}, // 0x62 'b'
+	{0x00,0x38,0x44,0x44,0x44,0x20}, // 0x63 'c'
+	{0x00,0x38,0x44,0x44,0x48,0x7F}, // 0x64 'd'
+	{0x00,0x38,0x54,0x54,0x54,0x18}, // 0x65 'e'
+	{0x00,0x08,0x7E,0x09,0x01,0x02}, // 0x66 'f'
+	{0x00,0x0C,0x52,0x52,0x52,0x3E}, // 0x67 'g'
+	{0x00,0x7F,0x08,0x04,0x04,0x78}, // 0x68 'h'
+	{0x00,0x00,0x44,0x7D,0x40,0x00}, // 0x69 'i'
+	{0x00,0x20,0x40,0x44,0x3D,0x00}, // 0x6A 'j'
+	{0x00,0x7F,0x10,0x28,0x44,0x00}, // 0x6B 'k'
+	{0x00,0x00,0x41,0x7F,0x40,0x00}, // 0x6C 'l'
+	{0x00,0x78,0x04,0x18,0x04,0x78}, // 0x6D 'm'
+	{0x00,0x7C,0x08,0x04,0x04,0x78}, // 0x6E 'n'
+	{0x00,0x38,0x44,0x44,0x44,0x38}, // 0x6F 'o'
+	{0x00,0x7C,0x14,0x14,0x14,0x08}, // 0x70 'p'
+	{0x00,0x08,0x14,0x14,0x18,0x7C}, // 0x71 'q'
+	{0x00,0x7C,0x08,0x04,0x04,0x08}, // 0x72 'r'
+	{0x00,0x48,0x54,0x54,0x54,0x20}, // 0x73 's'
+	{0x00,0x04,0x3F,0x44,0x40,0x20}, // 0x74 't'
+	{0x00,0x3C,0x40,0x40,0x20,0x7C}, // 0x75 'u'
+	{0x00,0x1C,0x20,0x40,0x20,0x1C}, // 0x76 'v'
+	{0x00,0x3C,0x40,0x30,0x40,0x3C}, // 0x77 'w'
+	{0x00,0x44,0x28,0x10,0x28,0x44}, // 0x78 'x'
+	{0x00,0x0C,0x50,0x50,0x50,0x3C}, // 0x79 'y'
+	{0x00,0x44,0x64,0x54,0x4C,0x44}, // 0x7A 'z'
+	{0x00,0x00,0x08,0x36,0x41,0x00}, // 0x7B '{'
+	{0x00,0x00,0x00,0x7F,0x00,0x00}, // 0x7C '|'
+	{0x00,0x00,0x41,0x36,0x08,0x00}, // 0x7D '}'
+	{0x00,0x0C,0x02,0x0C,0x10,0x0C}, // 0x7E '~'
+#ifdef CONFIG_FONT_8BIT
+	{0x00,0x00,0x00,0x00,0x00,0x00}, // 0x7F unused
+	{0x00,0x00,0x00,0x00,0x00,0x00}, // 0x80 blank
+	{0x00,0x08,0x1C,0x3E,0x1C,0x08}, // 0x81 diamond
+	{0xAA,0x55,0xAA,0x55,0xAA,0x55}, // 0x82 checkerboard
+	{0x00,0x07,0x02,0x0F,0x78,0x08}, // 0x83 HT
+	{0x00,0x0F,0x05,0x79,0x28,0x08}, // 0x84 FF
+	{0x00,0x02,0x05,0x7D,0x28,0x50}, // 0x85 CR
+	{0x00,0x07,0x04,0x7C,0x28,0x08}, // 0x86 LF
+	{0x00,0x02,0x05,0x05,0x02,0x00}, // 0x87 degree
+	{0x00,0x44,0x44,0x5F,0x44,0x44}, // 0x88 plus/minus
+	{0x00,0x0F,0x02,0x74,0x4F,0x40}, // 0x89 NL
+	{0x00,0x03,0x0C,0x0B,0x78,0x08}, // 0x8A VT
+	{0x08,0x08,0x08,0x0F,0x00,0x00}, // 0x8B lower right corner
+	{0x08,0x08,0x08,0xF8,0x00,0x00}, // 0x8C upper right corner
+	{0x00,0x00,0x00,0xF8,0x08,0x08}, // 0x8D upper left corner
+	{0x00,0x00,0x00,0x0F,0x08,0x08}, // 0x8E lower left corner
+	{0x08,0x08,0x08,0xFF,0x08,0x08}, // 0x8F crossing lines
+	{0x01,0x01,0x01,0x01,0x01,0x01}, // 0x90 scan line 1
+	{0x02,0x02,0x02,0x02,0x02,0x02}, // 0x91 scan line 3
+	{0x08,0x08,0x08,0x08,0x08,0x08}, // 0x92 scan line 5, horizontal line
+	{0x20,0x20,0x20,0x20,0x20,0x20}, // 0x93 scan line 7
+	{0x80,0x80,0x80,0x80,0x80,0x80}, // 0x94 scan line 9
+	{0x00,0x00,0x00,0xFF,0x08,0x08}, // 0x95 left tee
+	{0x08,0x08,0x08,0xFF,0x00,0x00}, // 0x96 right tee
+	{0x08,0x08,0x08,0x0F,0x08,0x08}, // 0x97 bottom tee
+	{0x08,0x08,0x08,0xF8,0x08,0x08}, // 0x98 top tee
+	{0x00,0x00,0x00,0xFF,0x00,0x00}, // 0x99 vertical line
+	{0x00,0x00,0x44,0x4A,0x51,0x00}, // 0x9A less than or equal
+	{0x00,0x00,0x51,0x4A,0x44,0x00}, // 0x9B greater than or equal
+	{0x00,0x02,0x3E,0x02,0x3E,0x02}, // 0x9C pi
+	{0x00,0x1A,0x0A,0x0E,0x0B,0x0A}, // 0x9D not equal
+	{0x00,0x28,0x5E,0x69,0x01,0x22}, // 0x9E pound sterling
+	{0x00,0x00,0x00,0x08,0x00,0x00}, // 0x9F centered dot
+#endif
+};
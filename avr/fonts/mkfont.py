@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+Convert a text bitmap font into a C header for the AVR.
+
+    mkfont.py name source.txt > name.h
+
+The source has "width N" and "height N" lines, then one block per
+glyph: a line with the code in hex (and anything after it as a
+comment), followed by one line per row of pixels, '#' for set and
+'.' for clear.  Blank lines and lines starting with '#' outside a
+glyph are ignored.
+
+Each glyph is stored as one byte per column with the top row in
+the LSB, so the height can be at most 8.  The table starts at the
+first code and has no holes; missing codes are filled with blanks.
+Codes from 0x80 up are only compiled with CONFIG_FONT_8BIT.
+"""
+import sys
+
+
+def die(msg):
+    sys.stderr.write("mkfont: %s\n" % msg)
+    sys.exit(1)
+
+
+def parse(lines):
+    width = height = None
+    glyphs = {}
+    i = 0
+    while i < len(lines):
+        line = lines[i].rstrip("\n")
+        i += 1
+        words = line.split()
+        if not words or line.startswith("#"):
+            continue
+        if words[0] == "width":
+            width = int(words[1])
+            continue
+        if words[0] == "height":
+            height = int(words[1])
+            continue
+
+        if width is None or height is None:
+            die("line %d: glyph before width and height" % i)
+        if not 1 <= height <= 8:
+            die("height must be 1 to 8")
+
+        code = int(words[0], 16)
+        if code in glyphs:
+            die("line %d: code 0x%02X defined twice" % (i, code))
+
+        rows = [r.rstrip("\n") for r in lines[i:i + height]]
+        i += height
+        if len(rows) != height or any(len(r) != width for r in rows):
+            die("glyph 0x%02X is not %dx%d" % (code, width, height))
+
+        cols = []
+        for x in range(width):
+            bits = 0
+            for y in range(height):
+                if rows[y][x] == "#":
+                    bits |= 1 << y
+                elif rows[y][x] != ".":
+                    die("glyph 0x%02X: bad pixel %r" % (code, rows[y][x]))
+            cols.append(bits)
+        glyphs[code] = (cols, " ".join(words[1:]))
+
+    if not glyphs:
+        die("no glyphs")
+    return width, height, glyphs
+
+
+def main():
+    if len(sys.argv) != 3:
+        die("usage: mkfont.py name source.txt")
+    name, source = sys.argv[1], sys.argv[2]
+
+    with open(source) as f:
+        width, height, glyphs = parse(f.readlines())
+
+    first = min(glyphs)
+    last = max(c for c in glyphs if c < 0x80) if min(glyphs) < 0x80 else first
+    last8 = max(glyphs)
+    upper = name.upper()
+
+    out = sys.stdout
+    out.write("/** \\file\n")
+    out.write(" * %dx%d font, generated by fonts/mkfont.py from fonts/%s.\n"
+              % (width, height, source.split("/")[-1]))
+    out.write(" * Do not edit; change the source bitmap and run \"make fonts\".\n")
+    out.write(" */\n")
+    out.write("#define %s_WIDTH\t%d\n" % (upper, width))
+    out.write("#define %s_HEIGHT\t%d\n" % (upper, height))
+    out.write("#define %s_FIRST\t0x%02X\n" % (upper, first))
+    if last8 != last:
+        out.write("#ifdef CONFIG_FONT_8BIT\n")
+        out.write("#define %s_LAST\t0x%02X\n" % (upper, last8))
+        out.write("#else\n")
+        out.write("#define %s_LAST\t0x%02X\n" % (upper, last))
+        out.write("#endif\n")
+    else:
+        out.write("#define %s_LAST\t0x%02X\n" % (upper, last))
+    out.write("\n")
+    out.write("static const uint8_t %s[][%d] PROGMEM =\n{\n" % (name, width))
+
+    for code in range(first, last8 + 1):
+        if code == last + 1:
+            out.write("#ifdef CONFIG_FONT_8BIT\n")
+        cols, comment = glyphs.get(code, ([0] * width, "unused"))
+        out.write("\t{%s}, // 0x%02X %s\n" % (
+            ",".join("0x%02X" % b for b in cols), code, comment))
+    if last8 != last:
+        out.write("#endif\n")
+
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
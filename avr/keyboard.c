@@ -4,6 +4,15 @@
  * Keyboard needs:
  *	9 columns, shared with the 10 LCD chipselect lines
  *	8 rows, must not be shared.
+ *
+ * The matrix is scanned one column per Timer 0 tick.  The interrupt
+ * only counts the ticks and the main loop does the scan, so the
+ * settling time for each column does not hold off the serial receive
+ * interrupt, and the scan never lands in the middle of an LCD
+ * transfer.  Ticks that pass during a long redraw are skipped, not
+ * made up, so the debouncing and the repeat rate never see columns
+ * scanned back to back.  Since the columns are the LCD chip selects,
+ * the port state is still saved and restored around each column.
  */
 
 #include <avr/io.h>
@@ -38,6 +47,18 @@
 #define KEY_MOD_NC	0x40
 #define KEY_MOD_BREAK	0x80
 
+// Columns 0-7 are on port F, column 8 is the modifier column
+#define KEY_COLS	8
+
+// Time for the rows to settle after driving a column
+#define KEY_SETTLE_US	20
+
+// Must be a power of two
+#define KEY_QUEUE_SIZE	16
+
+// No key is being repeated
+#define KEY_NONE	0xFF
+
 
 /** Layout of the rows and columns in normal mode */
 static const uint8_t key_codes[8][8] PROGMEM =
@@ -67,6 +88,36 @@ static const uint8_t shift_codes[8][8] PROGMEM =
 };
 
 
+/** Debounced state of every key, one bit per row in each column,
+ * along with the previous and partially complete sweeps.
+ */
+static uint8_t key_state[KEY_COLS + 1];
+static uint8_t key_scan[KEY_COLS + 1];
+static uint8_t key_last[KEY_COLS + 1];
+static uint8_t key_col;
+
+/** Typematic state, all in ticks of KEY_TICK_HZ */
+static uint16_t key_repeat_delay = KEY_TICK_HZ / 2; // 500 ms
+static uint8_t key_repeat_period = KEY_TICK_HZ / 20; // 20 per second
+static uint16_t key_repeat_timer;
+static uint8_t key_repeat_code = KEY_NONE;
+
+/** Event queue, filled by keyboard_tick() and drained by
+ * keyboard_event().
+ */
+static keyboard_event_t key_queue[KEY_QUEUE_SIZE];
+static uint8_t key_head;
+static uint8_t key_tail;
+
+/** Port state saved while the columns are borrowed from the LCD */
+static uint8_t saved_rows_ddr;
+static uint8_t saved_rows_port;
+static uint8_t saved_cols_ddr;
+static uint8_t saved_cols_port;
+static uint8_t saved_mod_ddr;
+static uint8_t saved_mod_port;
+
+
 /** Initialize the keyboard for a scan.
  *
  * This is called before each read of the keyboard, unlike the
@@ -75,6 +126,13 @@ static const uint8_t shift_codes[8][8] PROGMEM =
 static void
 keyboard_init(void)
 {
+	saved_rows_ddr = KEY_ROWS_DDR;
+	saved_rows_port = KEY_ROWS_PORT;
+	saved_cols_ddr = KEY_COLS_DDR;
+	saved_cols_port = KEY_COLS_PORT;
+	saved_mod_ddr = DDRE;
+	saved_mod_port = PORTE;
+
 	// KEY_Cx configuration is handled in lcd_init() sincej
 	// they are shared with the chip select lines of the LCD 
 	KEY_ROWS_DDR = 0x00; // all input
@@ -91,19 +149,36 @@ keyboard_init(void)
 
 /** Return the keyboard to the normal state (LCD writing).
  *
+ * The ports are put back exactly as they were, since the LCD
+ * may have been part way through a flush.
  */
 static void
 keyboard_reset(void)
 {
-	KEY_ROWS_DDR = 0x00; // all inputs
-	KEY_ROWS_PORT = 0x00; // all tri-state
+	KEY_ROWS_DDR = saved_rows_ddr;
+	KEY_ROWS_PORT = saved_rows_port;
 
-	KEY_COLS_DDR = 0xFF; // leave as all output
-	KEY_COLS_PORT = 0x00; // all low
+	KEY_COLS_PORT = saved_cols_port;
+	KEY_COLS_DDR = saved_cols_ddr;
 
-	// Reset the function key modifier to pull down, too
-	ddr(KEY_COLS_MOD, 1);
-	out(KEY_COLS_MOD, 0);
+	PORTE = saved_mod_port;
+	DDRE = saved_mod_ddr;
+}
+
+
+static void
+keyboard_push(
+	const uint8_t code,
+	const uint8_t mods
+)
+{
+	const uint8_t head = key_head;
+	if ((uint8_t)(head - key_tail) == KEY_QUEUE_SIZE)
+		return; // full, drop the event
+
+	key_queue[head % KEY_QUEUE_SIZE].code = code;
+	key_queue[head % KEY_QUEUE_SIZE].mods = mods;
+	key_head = head + 1;
 }
 
 
@@ -153,42 +228,201 @@ keyboard_scancode_convert(
 }
 
 
-/** Check to see if there are any keys held down.
+/** Check for keys that might be ghosts.
  *
- * \todo Scans only one column per call?
- *
- * \todo Multiple keys held?
- *
- * \return 0 if no keys are held down
+ * If two columns share two or more pressed rows then three real
+ * keys can make a fourth appear at the corner of the rectangle.
+ * The diodes on every key should prevent that, but a damaged
+ * diode would produce phantom keystrokes, so such sweeps are
+ * treated as ambiguous.
  */
-uint8_t
-keyboard_scan(void)
+static uint8_t
+keyboard_ghosted(
+	const uint8_t * const scan
+)
 {
-	keyboard_init();
+	for (uint8_t a = 0 ; a < KEY_COLS ; a++)
+	{
+		if (!scan[a])
+			continue;
 
+		for (uint8_t b = a + 1 ; b <= KEY_COLS ; b++)
+		{
+			const uint8_t common = scan[a] & scan[b];
+			if (common & (common - 1))
+				return 1;
+		}
+	}
+
+	return 0;
+}
 
-	// Scan the modifier column first, which is on the separate pin
-	out(KEY_COLS_MOD, 0);
-	_delay_us(50);
-	const uint8_t mods = ~KEY_ROWS_PIN;
-	out(KEY_COLS_MOD, 1);
 
-	uint8_t mask = 1;
-	for (uint8_t col = 0 ; col < 8 ; col++, mask <<= 1)
+/** Process a complete sweep of the matrix.
+ *
+ * A sweep has to match the previous one to be accepted, which
+ * debounces the switches.  Every key that changed state since the
+ * last accepted sweep generates an event, so any number of keys
+ * can be held at once.  Ambiguous sweeps are ignored until the
+ * keys that caused them are released.
+ */
+static void
+keyboard_sweep(void)
+{
+	if (memcmp(key_scan, key_last, sizeof(key_scan)) != 0)
 	{
-		KEY_COLS_PORT = ~mask; // pull one down
-		_delay_us(50); // wait for things to stabilize
-		uint8_t rows = ~KEY_ROWS_PIN;
-		KEY_COLS_PORT = 0xFF; // bring them all back up
+		memcpy(key_last, key_scan, sizeof(key_scan));
+		return;
+	}
+
+	if (keyboard_ghosted(key_scan))
+		return;
 
-		if (!rows)
+	const uint8_t mods = key_scan[KEY_COLS];
+
+	for (uint8_t col = 0 ; col < KEY_COLS ; col++)
+	{
+		const uint8_t rows = key_scan[col];
+		const uint8_t changed = rows ^ key_state[col];
+		if (!changed)
 			continue;
 
-		keyboard_reset();
+		for (uint8_t row = 0, mask = 1 ; row < 8 ; row++, mask <<= 1)
+		{
+			if ((changed & mask) == 0)
+				continue;
+
+			const uint8_t code = col * 8 + row;
+
+			if (rows & mask)
+			{
+				keyboard_push(code, mods);
+
+				// The most recently pressed key repeats
+				key_repeat_code = code;
+				key_repeat_timer = key_repeat_delay;
+			} else {
+				keyboard_push(code | KEY_RELEASE, mods);
+
+				if (code == key_repeat_code)
+					key_repeat_code = KEY_NONE;
+			}
+		}
+	}
+
+	memcpy(key_state, key_scan, sizeof(key_state));
+}
+
 
-		return keyboard_scancode_convert(col, rows, mods);
+/** Generate repeated presses for a key that is being held down.
+ *
+ * This only counts ticks; it adds no time to the scan.
+ */
+static void
+keyboard_autorepeat(void)
+{
+	if (key_repeat_code == KEY_NONE || key_repeat_period == 0)
+		return;
+
+	if (--key_repeat_timer != 0)
+		return;
+
+	key_repeat_timer = key_repeat_period;
+	keyboard_push(key_repeat_code, key_state[KEY_COLS]);
+}
+
+
+/** Scan one column of the matrix.
+ *
+ * Called at most once for every Timer 0 tick; a full sweep of all
+ * nine columns takes at least nine ticks.
+ */
+void
+keyboard_tick(void)
+{
+	uint8_t rows;
+
+	keyboard_autorepeat();
+
+	keyboard_init();
+
+	if (key_col == KEY_COLS)
+	{
+		// The modifier column is on the separate pin
+		out(KEY_COLS_MOD, 0);
+		_delay_us(KEY_SETTLE_US);
+		rows = ~KEY_ROWS_PIN;
+		out(KEY_COLS_MOD, 1);
+	} else {
+		KEY_COLS_PORT = ~(1 << key_col); // pull one down
+		_delay_us(KEY_SETTLE_US); // wait for things to stabilize
+		rows = ~KEY_ROWS_PIN;
+		KEY_COLS_PORT = 0xFF; // bring them all back up
 	}
 
 	keyboard_reset();
-	return 0;
+
+	key_scan[key_col] = rows;
+
+	if (key_col++ != KEY_COLS)
+		return;
+
+	key_col = 0;
+	keyboard_sweep();
+}
+
+
+uint8_t
+keyboard_event(
+	keyboard_event_t * const ev
+)
+{
+	const uint8_t tail = key_tail;
+	if (key_head == tail)
+		return 0;
+
+	*ev = key_queue[tail % KEY_QUEUE_SIZE];
+	key_tail = tail + 1;
+	return 1;
+}
+
+
+uint8_t
+keyboard_ascii(
+	const keyboard_event_t * const ev
+)
+{
+	if (ev->code & KEY_RELEASE)
+		return 0;
+
+	return keyboard_scancode_convert(
+		ev->code / 8,
+		1 << (ev->code % 8),
+		ev->mods
+	);
+}
+
+
+void
+keyboard_repeat_delay(
+	uint16_t ms
+)
+{
+	uint16_t ticks = ((uint32_t) ms * KEY_TICK_HZ) / 1000;
+	if (ticks == 0)
+		ticks = 1;
+
+	key_repeat_delay = ticks;
+}
+
+
+void
+keyboard_repeat_rate(
+	uint16_t rate
+)
+{
+	if (rate > KEY_TICK_HZ)
+		rate = KEY_TICK_HZ;
+
+	key_repeat_period = rate ? KEY_TICK_HZ / rate : 0;
 }
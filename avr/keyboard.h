@@ -8,15 +8,68 @@
 #include <stdint.h>
 
 
-/** Scan the row/col matrix for any keys held down.
+/** Key press or release, as reported by the background scanner.
  *
- * This will return the lowest key; multiple keys are not currently
- * supported.
+ * code is the matrix position (column * 8 + row) with KEY_RELEASE
+ * set for releases; mods is the state of the modifier column.
+ */
+typedef struct
+{
+	uint8_t code;
+	uint8_t mods;
+} keyboard_event_t;
+
+#define KEY_RELEASE	0x80
+
+/** Rate at which keyboard_tick() should be called */
+#define KEY_TICK_HZ	500
+
+
+/** Scan the next column of the row/col matrix.
+ *
+ * Called from the main loop at most once for every tick of the
+ * timer, not from the interrupt, since each column has to wait for
+ * the rows to settle.  Every debounced change of every key is queued
+ * as an event for keyboard_event(), so any number of keys may be
+ * held down at once.
+ */
+extern void
+keyboard_tick(void);
+
+
+/** Retrieve the next key event.
  *
- * \return ASCII code for key, or 0 for no key.
+ * \return 0 if there are no events waiting.
  */
 extern uint8_t
-keyboard_scan(void);
+keyboard_event(
+	keyboard_event_t * ev
+);
+
+
+/** Convert a key event to the character it types.
+ *
+ * \return ASCII code for key presses, or 0 for releases and keys
+ * that do not type anything.
+ */
+extern uint8_t
+keyboard_ascii(
+	const keyboard_event_t * ev
+);
+
+
+/** Set the time a key must be held before it starts repeating. */
+extern void
+keyboard_repeat_delay(
+	uint16_t ms
+);
+
+
+/** Set the number of repeats per second, or 0 to disable repeat. */
+extern void
+keyboard_repeat_rate(
+	uint16_t rate
+);
 
 
 #endif
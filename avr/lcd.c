@@ -52,6 +52,102 @@
 #define LCD_CS28	0xE6
 #define LCD_CS29	0xE7
 
+// CS20-CS27 are all of port F, CS28 and CS29 are the top of port E,
+// so a mask of chips can be selected with two port writes.
+// Bit 0 is CS20 (top left), bit 5 is CS25 (bottom left).
+#define LCD_CS_PORT	PORTF
+#define LCD_CS_HI_PORT	PORTE
+#define LCD_CHIPS_ALL	0x3FF
+
+#define LCD_CHIP_WIDTH	50 // columns per controller
+
+
+/** Shadow copy of the display RAM, one byte per column per page.
+ *
+ * All drawing goes here first so that the controllers never have
+ * to be read back, which costs two bus round trips per byte.
+ */
+static uint8_t lcd_fb[LCD_PAGES][LCD_WIDTH];
+
+/** Display start page shared by all of the controllers.
+ *
+ * Scrolling is done by rotating the start page, so logical page
+ * y is stored in physical page (y + lcd_start_page) % 4 of its chip.
+ */
+static uint8_t lcd_start_page;
+static uint8_t lcd_start_pending;
+
+/** Columns waiting to be sent to each controller, one span per page.
+ *
+ * Spans are in chip coordinates (0 to 50); lo >= hi means clean.
+ */
+static uint8_t lcd_dirty_lo[LCD_PAGES][5];
+static uint8_t lcd_dirty_hi[LCD_PAGES][5];
+static uint8_t lcd_pending;
+
+/** Chips currently selected by lcd_select() */
+static uint16_t lcd_selected;
+
+#ifdef CONFIG_LCD_STATS
+lcd_stats_t lcd_stats;
+#define lcd_stat(field)	(lcd_stats.field++)
+#else
+#define lcd_stat(field)	do {} while (0)
+#endif
+
+#ifdef CONFIG_LCD_BUSY_POLL
+/** Status byte read after each transfer has the busy flag in the MSB */
+#define LCD_STATUS_BUSY		0x80
+
+/** Time from the rising edge of enable to valid status data */
+#define LCD_BUSY_DELAY_US	1
+
+/** Number of polls before deciding the busy flag is not working */
+#define LCD_BUSY_TRIES		32
+
+static uint8_t lcd_busy_poll = 1;
+#endif
+
+
+static inline void
+lcd_cs(
+	const uint16_t chips,
+	const uint8_t value
+)
+{
+	if (value)
+	{
+		LCD_CS_PORT |= chips & 0xFF;
+		LCD_CS_HI_PORT |= (chips >> 2) & 0xC0;
+	} else {
+		LCD_CS_PORT &= ~(chips & 0xFF);
+		LCD_CS_HI_PORT &= ~((chips >> 2) & 0xC0);
+	}
+}
+
+
+/** Raise the select lines for one or more chips.
+ *
+ * All of the selected chips latch every byte written, so identical
+ * data can be sent to several of them in one transfer.
+ */
+static void
+lcd_select(
+	const uint16_t chips
+)
+{
+	lcd_selected = chips;
+	lcd_cs(chips, 1);
+}
+
+
+static void
+lcd_deselect(void)
+{
+	lcd_cs(lcd_selected, 0);
+	lcd_selected = 0;
+}
+
 
 static uint8_t
 lcd_command(
@@ -62,6 +158,18 @@ lcd_command(
 {
 	uint8_t rc = 0;
 
+#ifdef CONFIG_LCD_STATS
+	const uint16_t start = TCNT3;
+#endif
+
+	if (!write_dir)
+		lcd_stat(reads);
+	else
+	if (di)
+		lcd_stat(writes);
+	else
+		lcd_stat(commands);
+
 	out(LCD_DI, di);
 	out(LCD_RW, !write_dir); // write
 	if (write_dir)
@@ -91,17 +199,70 @@ lcd_command(
 	LCD_DATA_PORT = 0x00; // no pull ups
 	LCD_DATA_DDR = 0x00;
 
+	// Only one chip may drive the bus for the status read.  The
+	// others are executing the same transfer, so they will be
+	// ready at the same time.
+	const uint16_t others = lcd_selected & (lcd_selected - 1);
+	if (others)
+		lcd_cs(others, 0);
+
 	out(LCD_DI, 0); // status command
 	out(LCD_RW, 1); // read
 
-	out(LCD_EN, 1);
-	_delay_us(10);
-	if (write_dir)
-		rc = LCD_DATA_PIN;
-	out(LCD_EN, 0);
+#ifdef CONFIG_LCD_BUSY_POLL
+	if (lcd_busy_poll)
+	{
+		// Poll the busy flag until the chip is ready for the
+		// next byte.  If it never clears the chip is probably
+		// not answering reads, so give up on polling and go
+		// back to the fixed delay for the rest of the session.
+		uint8_t tries = LCD_BUSY_TRIES;
+		uint8_t status;
+
+		while (1)
+		{
+			out(LCD_EN, 1);
+			lcd_stat(status);
+			_delay_us(LCD_BUSY_DELAY_US);
+			status = LCD_DATA_PIN;
+			out(LCD_EN, 0);
+
+			if ((status & LCD_STATUS_BUSY) == 0)
+				break;
+
+			lcd_stat(busy);
+			if (--tries == 0)
+			{
+				lcd_stat(timeouts);
+				lcd_busy_poll = 0;
+				_delay_us(10);
+				break;
+			}
+		}
+
+		if (write_dir)
+			rc = status;
+	} else
+#endif
+	{
+		out(LCD_EN, 1);
+		lcd_stat(status);
+		_delay_us(10);
+		if (write_dir)
+			rc = LCD_DATA_PIN;
+		out(LCD_EN, 0);
+	}
 
 	// Everything looks good.
 	out(LCD_RW, 0); // go back into write mode
+
+	if (others)
+		lcd_cs(others, 1);
+
+#ifdef CONFIG_LCD_STATS
+	lcd_stats.cycles += (uint16_t)(TCNT3 - start);
+#endif
+
 	return rc;
 }
 
@@ -219,6 +380,13 @@ lcd_init(void)
 	cbi(TCCR1B, CS11);
 	sbi(TCCR1B, CS10);
 
+#ifdef CONFIG_LCD_STATS
+	// Timer 3 free runs at clk/1 to count the cycles spent
+	// on the LCD bus.
+	TCCR3A = 0;
+	TCCR3B = 1 << CS30;
+#endif
+
 	lcd_vee(0x100); // 50% duty cycle
 	lcd_contrast(0x280); // almost +5V
 	
@@ -249,26 +417,185 @@ lcd_init(void)
 }
 
 
-/** Enable the one chip, select the address and send/recv the byte.
+/** Enable the chips, select the address and send the bytes.
  *
- * x goes from 0 to 50, y goes from 0 to 32, rounded to 8.
+ * x goes from 0 to 50, page is the physical page from 0 to 3.
+ * All of the chips in the mask receive the same data.
  */
 static void
 lcd_bulk_write(
-	const uint8_t pin,
+	const uint16_t chips,
 	uint8_t x,
-	uint8_t y,
+	uint8_t page,
 	const uint8_t * buf,
 	uint8_t n
 )
 {
-	out(pin, 1);
-	lcd_command((y >> 3) << 6 | x, 0, 1);
+	lcd_select(chips);
+	lcd_command(page << 6 | x, 0, 1);
 
 	for (uint8_t i = 0 ; i < n ; i++)
 		lcd_command(buf[i], 1, 1);
 
-	out(pin, 0);
+	lcd_deselect();
+}
+
+
+/** Mark n columns of the shadow framebuffer as needing a flush.
+ *
+ * The span is split at the 50 pixel boundaries between the
+ * controllers, so it may be as long as the entire row.
+ */
+static void
+lcd_dirty(
+	uint8_t x,
+	uint8_t page,
+	uint8_t n
+)
+{
+	while (n)
+	{
+		const uint8_t chip = x / LCD_CHIP_WIDTH;
+		const uint8_t chip_x = x - chip * LCD_CHIP_WIDTH;
+		uint8_t len = LCD_CHIP_WIDTH - chip_x;
+		if (len > n)
+			len = n;
+
+		uint8_t * const lo = &lcd_dirty_lo[page][chip];
+		uint8_t * const hi = &lcd_dirty_hi[page][chip];
+
+		if (*lo >= *hi)
+		{
+			*lo = chip_x;
+			*hi = chip_x + len;
+		} else {
+			if (chip_x < *lo)
+				*lo = chip_x;
+			if (chip_x + len > *hi)
+				*hi = chip_x + len;
+		}
+
+		x += len;
+		n -= len;
+	}
+}
+
+
+/** Copy n columns into page of the shadow framebuffer at x.
+ *
+ * Only the columns that actually change are marked dirty, with
+ * one span per controller, so redrawing identical data or moving
+ * a region over a similar one costs nothing on the bus.  The
+ * source may overlap the destination.
+ */
+static void
+lcd_store(
+	uint8_t x,
+	uint8_t page,
+	const uint8_t * src,
+	uint8_t n
+)
+{
+	uint8_t * const dst = &lcd_fb[page][x];
+	uint8_t i = 0;
+
+	while (i < n)
+	{
+		if (dst[i] == src[i])
+		{
+			i++;
+			continue;
+		}
+
+		// Find the last change on this controller
+		const uint8_t chip_end = ((x + i) / LCD_CHIP_WIDTH + 1)
+			* LCD_CHIP_WIDTH - x;
+		uint8_t last = i;
+
+		for (uint8_t j = i + 1 ; j < n && j < chip_end ; j++)
+			if (dst[j] != src[j])
+				last = j;
+
+		lcd_dirty(x + i, page, last - i + 1);
+		lcd_pending = 1;
+		i = chip_end;
+	}
+
+	memmove(dst, src, n);
+}
+
+
+/** Send any pending start page change and all of the dirty spans.
+ *
+ * Each span costs one address command and then streams its bytes
+ * with the controller's auto-increment.
+ */
+void
+lcd_flush(void)
+{
+	if (!lcd_pending)
+		return;
+
+	out(LCD_CS1, 1);
+
+	if (lcd_start_pending)
+	{
+		lcd_select(LCD_CHIPS_ALL);
+		lcd_command(lcd_start_page << 6 | 0x3E, 0, 1);
+		lcd_deselect();
+
+		lcd_start_pending = 0;
+	}
+
+	for (uint8_t page = 0 ; page < LCD_PAGES ; page++)
+	{
+		const uint8_t phys_page = (page + lcd_start_page) & 3;
+		const uint8_t shift = page < 4 ? 0 : 5;
+		uint8_t done = 0;
+
+		for (uint8_t chip = 0 ; chip < 5 ; chip++)
+		{
+			const uint8_t lo = lcd_dirty_lo[page][chip];
+			const uint8_t hi = lcd_dirty_hi[page][chip];
+			if (lo >= hi || (done & (1 << chip)))
+				continue;
+
+			// Any other chip on this page with the same span and
+			// the same contents can be written at the same time,
+			// which is common for blank areas.
+			const uint8_t * const buf
+				= &lcd_fb[page][chip * LCD_CHIP_WIDTH + lo];
+			uint8_t chips = 1 << chip;
+
+			for (uint8_t other = chip + 1 ; other < 5 ; other++)
+			{
+				if (lcd_dirty_lo[page][other] != lo
+				||  lcd_dirty_hi[page][other] != hi)
+					continue;
+				if (memcmp(buf, &lcd_fb[page][other * LCD_CHIP_WIDTH + lo], hi - lo) != 0)
+					continue;
+				chips |= 1 << other;
+			}
+
+			lcd_bulk_write(
+				(uint16_t) chips << shift,
+				lo,
+				phys_page,
+				buf,
+				hi - lo
+			);
+
+			done |= chips;
+		}
+
+		memset(lcd_dirty_lo[page], 0, sizeof(lcd_dirty_lo[page]));
+		memset(lcd_dirty_hi[page], 0, sizeof(lcd_dirty_hi[page]));
+	}
+
+	out(LCD_CS1, 0);
+
+	lcd_pending = 0;
+	lcd_stat(frames);
 }
 
 
@@ -276,6 +603,10 @@ lcd_bulk_write(
  *
  * x is ranged 0 to 240, for each pixel
  * y is ranged 0 to 64, rounded to 8
+ *
+ * The columns are copied into the shadow framebuffer and the ones
+ * that changed are marked dirty.  Unless CONFIG_LCD_DEFERRED is set
+ * they are flushed to the display immediately.
  */
 void
 lcd_write(
@@ -285,110 +616,213 @@ lcd_write(
 	uint8_t n
 )
 {
-	out(LCD_CS1, 1);
+	lcd_stat(write_calls);
+
+	if (x >= LCD_WIDTH || y >= LCD_HEIGHT)
+		return;
+	if (n > LCD_WIDTH - x)
+		n = LCD_WIDTH - x;
+
+	lcd_store(x, y >> 3, buf, n);
+
+#ifndef CONFIG_LCD_DEFERRED
+	lcd_flush();
+#endif
+}
+
+
+void
+lcd_read(
+	uint8_t x,
+	uint8_t y,
+	uint8_t * buf,
+	uint8_t n
+)
+{
+	lcd_stat(read_calls);
+
+	if (x >= LCD_WIDTH || y >= LCD_HEIGHT)
+		return;
+	if (n > LCD_WIDTH - x)
+		n = LCD_WIDTH - x;
+
+	memcpy(buf, &lcd_fb[y >> 3][x], n);
+}
+
+
+/** Write the same columns to several controllers at once.
+ *
+ * chips is a mask with bit 0 for CS20 through bit 9 for CS29,
+ * x is ranged 0 to 50 within each chip and y 0 to 32 within each
+ * half of the panel.  The data goes straight to the display, even
+ * in deferred mode, since this is used for large fills.
+ */
+void
+lcd_write_multi(
+	uint16_t chips,
+	uint8_t x,
+	uint8_t y,
+	const uint8_t * buf,
+	uint8_t n
+)
+{
+	if (x >= LCD_CHIP_WIDTH || y >= LCD_HEIGHT / 2)
+		return;
+	if (n > LCD_CHIP_WIDTH - x)
+		n = LCD_CHIP_WIDTH - x;
 
-	if (y < 32)
+	const uint8_t page = y >> 3;
+
+	for (uint8_t chip = 0 ; chip < 10 ; chip++)
 	{
-		// Top half of the display
-		if (x < 50)
-			lcd_bulk_write(LCD_CS20, x - 0, y - 0, buf, n);
-		else
-		if (x < 100)
-			lcd_bulk_write(LCD_CS21, x - 50, y - 0, buf, n);
-		else
-		if (x < 150)
-			lcd_bulk_write(LCD_CS22, x - 100, y - 0, buf, n);
-		else
-		if (x < 200)
-			lcd_bulk_write(LCD_CS23, x - 150, y - 0, buf, n);
-		else
-			lcd_bulk_write(LCD_CS24, x - 200, y - 0, buf, n);
-	} else {
-		// Bottom half of the display
-		if (x < 50)
-			lcd_bulk_write(LCD_CS25, x - 0, y - 32, buf, n);
-		else
-		if (x < 100)
-			lcd_bulk_write(LCD_CS26, x - 50, y - 32, buf, n);
-		else
-		if (x < 150)
-			lcd_bulk_write(LCD_CS27, x - 100, y - 32, buf, n);
-		else
-		if (x < 200)
-			lcd_bulk_write(LCD_CS28, x - 150, y - 32, buf, n);
-		else
-			lcd_bulk_write(LCD_CS29, x - 200, y - 32, buf, n);
+		if ((chips & (1 << chip)) == 0)
+			continue;
+
+		// The last chip of each half only shows 40 of its
+		// columns; the rest are sent but have no shadow copy.
+		const uint8_t col = (chip % 5) * LCD_CHIP_WIDTH + x;
+		if (col >= LCD_WIDTH)
+			continue;
+		const uint8_t len = n > LCD_WIDTH - col ? LCD_WIDTH - col : n;
+
+		memcpy(&lcd_fb[chip < 5 ? page : page + 4][col], buf, len);
 	}
 
+	out(LCD_CS1, 1);
+	lcd_bulk_write(chips, x, (page + lcd_start_page) & 3, buf, n);
 	out(LCD_CS1, 0);
 }
 
 
-/** Enable the one chip, select the address and send/recv the byte.
+/** Blank the entire display.
  *
- * x goes from 0 to 50, y goes from 0 to 32, rounded to 8.
+ * All ten controllers are written together, so this costs
+ * one tenth of drawing each of them.
  */
-static void
-lcd_bulk_read(
-	const uint8_t pin,
+void
+lcd_clear(void)
+{
+	static const uint8_t blank[LCD_CHIP_WIDTH];
+
+	lcd_stat(clears);
+
+	for (uint8_t y = 0 ; y < LCD_HEIGHT / 2 ; y += 8)
+		lcd_write_multi(LCD_CHIPS_ALL, 0, y, blank, LCD_CHIP_WIDTH);
+
+	// Everything on the panel now matches the shadow copy
+	memset(lcd_dirty_lo, 0, sizeof(lcd_dirty_lo));
+	memset(lcd_dirty_hi, 0, sizeof(lcd_dirty_hi));
+}
+
+
+void
+lcd_refresh(void)
+{
+	for (uint8_t page = 0 ; page < LCD_PAGES ; page++)
+		lcd_dirty(0, page, LCD_WIDTH);
+
+	lcd_start_pending = 1;
+	lcd_pending = 1;
+
+#ifndef CONFIG_LCD_DEFERRED
+	lcd_flush();
+#endif
+}
+
+
+/** Scroll the display up by one page.
+ *
+ * The controllers do the work by advancing their display start
+ * page, which costs one command per chip.  Each half of the panel
+ * wraps around on its own, so the top half needs the page that
+ * scrolled off the top of the bottom half to be redrawn in its
+ * newly exposed bottom page, and the bottom half needs its new
+ * blank page.  That is two pages of writes instead of eight.
+ *
+ * Dirty spans stay with their physical location, so they move up
+ * a page along with the data.
+ */
+void
+lcd_scroll(void)
+{
+	lcd_stat(scrolls);
+
+	memmove(lcd_fb[0], lcd_fb[1], (LCD_PAGES - 1) * LCD_WIDTH);
+	memset(lcd_fb[LCD_PAGES - 1], 0, LCD_WIDTH);
+
+	memmove(lcd_dirty_lo[0], lcd_dirty_lo[1], sizeof(lcd_dirty_lo[0]) * (LCD_PAGES - 1));
+	memmove(lcd_dirty_hi[0], lcd_dirty_hi[1], sizeof(lcd_dirty_hi[0]) * (LCD_PAGES - 1));
+	lcd_dirty(0, 3, LCD_WIDTH);
+	lcd_dirty(0, 7, LCD_WIDTH);
+
+	lcd_start_page = (lcd_start_page + 1) & 3;
+	lcd_start_pending = 1;
+	lcd_pending = 1;
+
+#ifndef CONFIG_LCD_DEFERRED
+	lcd_flush();
+#endif
+}
+
+
+/** Copy n columns from src_x,src_y to x,y.
+ *
+ * This is a blit within the shadow framebuffer; the controllers
+ * have no way to move data, so the columns that end up different
+ * are rewritten on the next flush.  The regions may overlap.
+ */
+void
+lcd_move(
 	uint8_t x,
 	uint8_t y,
-	uint8_t * buf,
+	uint8_t src_x,
+	uint8_t src_y,
 	uint8_t n
 )
 {
-	out(pin, 1);
-	lcd_command((y >> 3) << 6 | x, 0, 1);
-	lcd_command(0, 1, 0); // dummy
-
-	for (int i = 0 ; i < n ; i++)
-		buf[i] = lcd_command(0, 1, 0);
-	out(pin, 0);
+	if (x >= LCD_WIDTH || y >= LCD_HEIGHT)
+		return;
+	if (src_x >= LCD_WIDTH || src_y >= LCD_HEIGHT)
+		return;
+	if (n > LCD_WIDTH - x)
+		n = LCD_WIDTH - x;
+	if (n > LCD_WIDTH - src_x)
+		n = LCD_WIDTH - src_x;
+
+	lcd_store(x, y >> 3, &lcd_fb[src_y >> 3][src_x], n);
+
+#ifndef CONFIG_LCD_DEFERRED
+	lcd_flush();
+#endif
 }
 
 
+/** Set n columns starting at x,y to val. */
 void
-lcd_read(
+lcd_fill(
 	uint8_t x,
 	uint8_t y,
-	uint8_t * buf,
+	uint8_t val,
 	uint8_t n
 )
 {
-	out(LCD_CS1, 1);
+	if (x >= LCD_WIDTH || y >= LCD_HEIGHT)
+		return;
+	if (n > LCD_WIDTH - x)
+		n = LCD_WIDTH - x;
+
+	uint8_t buf[LCD_CHIP_WIDTH];
+	memset(buf, val, sizeof(buf));
 
-	if (y < 32)
+	while (n)
 	{
-		// Top half of the display
-		if (x < 50)
-			lcd_bulk_read(LCD_CS20, x - 0, y - 0, buf, n);
-		else
-		if (x < 100)
-			lcd_bulk_read(LCD_CS21, x - 50, y - 0, buf, n);
-		else
-		if (x < 150)
-			lcd_bulk_read(LCD_CS22, x - 100, y - 0, buf, n);
-		else
-		if (x < 200)
-			lcd_bulk_read(LCD_CS23, x - 150, y - 0, buf, n);
-		else
-			lcd_bulk_read(LCD_CS24, x - 200, y - 0, buf, n);
-	} else {
-		// Bottom half of the display
-		if (x < 50)
-			lcd_bulk_read(LCD_CS25, x - 0, y - 32, buf, n);
-		else
-		if (x < 100)
-			lcd_bulk_read(LCD_CS26, x - 50, y - 32, buf, n);
-		else
-		if (x < 150)
-			lcd_bulk_read(LCD_CS27, x - 100, y - 32, buf, n);
-		else
-		if (x < 200)
-			lcd_bulk_read(LCD_CS28, x - 150, y - 32, buf, n);
-		else
-			lcd_bulk_read(LCD_CS29, x - 200, y - 32, buf, n);
+		const uint8_t len = n < sizeof(buf) ? n : sizeof(buf);
+		lcd_store(x, y >> 3, buf, len);
+		x += len;
+		n -= len;
 	}
 
-	out(LCD_CS1, 0);
+#ifndef CONFIG_LCD_DEFERRED
+	lcd_flush();
+#endif
 }
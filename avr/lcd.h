@@ -7,6 +7,36 @@
 #include <avr/io.h>
 #include <stdint.h>
 
+#define LCD_WIDTH	240
+#define LCD_HEIGHT	64
+#define LCD_PAGES	(LCD_HEIGHT / 8)
+
+
+#ifdef CONFIG_LCD_STATS
+/** Bus transaction counters, for measuring how much work each
+ * drawing operation costs.  The transfer counters are one strobe
+ * of the enable line each; bytes per second to the panel is
+ * (writes * F_CPU) / cycles.
+ */
+typedef struct
+{
+	uint32_t commands; // instruction bytes written
+	uint32_t writes; // data bytes written
+	uint32_t reads; // data bytes read from the display RAM
+	uint32_t status; // status bytes read after each transfer
+	uint32_t frames; // calls to lcd_flush() that sent anything
+	uint32_t busy; // status polls that found the chip busy
+	uint32_t timeouts; // times the busy flag never cleared
+	uint32_t cycles; // CPU cycles spent in bus transfers, from Timer 3
+	uint32_t scrolls; // calls to lcd_scroll()
+	uint32_t clears; // calls to lcd_clear()
+	uint32_t write_calls; // calls to lcd_write()
+	uint32_t read_calls; // calls to lcd_read()
+} lcd_stats_t;
+
+extern lcd_stats_t lcd_stats;
+#endif
+
 
 /** Bring up the LCD interface.
  *
@@ -16,7 +46,11 @@ extern void
 lcd_init(void);
 
 
-/** Display an array of N columns starting at position x,y */
+/** Display an array of N columns starting at position x,y
+ *
+ * If CONFIG_LCD_DEFERRED is defined this only updates the shadow
+ * framebuffer and the display is not changed until lcd_flush().
+ */
 extern void
 lcd_write(
 	uint8_t x,
@@ -26,7 +60,11 @@ lcd_write(
 );
 
 
-/** Read an array of N colums starting at position x,y */
+/** Read an array of N colums starting at position x,y
+ *
+ * This is served from the shadow framebuffer and does not touch
+ * the display bus.
+ */
 extern void
 lcd_read(
 	uint8_t x,
@@ -36,6 +74,81 @@ lcd_read(
 );
 
 
+/** Display the same N columns on several controllers at once.
+ *
+ * chips is a mask with bit 0 for CS20 (top left) through bit 4 for
+ * CS24 (top right), and bit 5 for CS25 (bottom left) through bit 9
+ * for CS29.  x is the column within each chip (0 to 50) and y is
+ * the row within each half of the display (0 to 32, rounded to 8).
+ */
+extern void
+lcd_write_multi(
+	uint16_t chips,
+	uint8_t x,
+	uint8_t y,
+	const uint8_t * buf,
+	uint8_t n
+);
+
+
+/** Blank the entire display, writing all controllers at once. */
+extern void
+lcd_clear(void);
+
+
+/** Send everything that has changed since the last flush.
+ *
+ * In deferred mode this should be called from the main loop when
+ * there is no input waiting, or at a fixed frame rate.
+ */
+extern void
+lcd_flush(void);
+
+
+/** Resend the entire shadow framebuffer to the display.
+ *
+ * This recovers from anything that has corrupted the display RAM.
+ */
+extern void
+lcd_refresh(void);
+
+
+/** Scroll the entire display up by one 8 pixel page.
+ *
+ * The bottom page is cleared.  This uses the controllers' display
+ * start page register, so only the two pages that wrap around
+ * between the halves of the panel are rewritten.
+ */
+extern void
+lcd_scroll(void);
+
+
+/** Copy N columns from src_x,src_y to x,y.
+ *
+ * y and src_y are rounded to 8.  The source and destination may
+ * overlap, so this can shift a row sideways or move rows up and
+ * down one at a time.  Only the columns that change are redrawn.
+ */
+extern void
+lcd_move(
+	uint8_t x,
+	uint8_t y,
+	uint8_t src_x,
+	uint8_t src_y,
+	uint8_t n
+);
+
+
+/** Set N columns starting at position x,y to val */
+extern void
+lcd_fill(
+	uint8_t x,
+	uint8_t y,
+	uint8_t val,
+	uint8_t n
+);
+
+
 /** Display a single vertical column val at position x,y.
  *
  * x is ranged 0 to 240, for each pixel
@@ -51,6 +51,11 @@ void send_str(const char *s)
 }
 
 
+/** Draw a test pattern on the screen.
+ *
+ * The characters go through the terminal's cell model like any
+ * other text, so that the host's first clear erases them.
+ */
 static void
 fill_screen(void)
 {
@@ -59,12 +64,18 @@ fill_screen(void)
 #if 1
 	for (uint8_t j = 0 ; j < 8 ; j++)
 	{
+		char row[40];
 		for (uint8_t i = 0 ; i < 40 ; i++)
 		{
 			val = (val + 1) & 0x3F;
-			font_draw(i, j, val + '0', FONT_NORMAL);
+			row[i] = val + '0';
 		}
+
+		vt100_goto(j + 1, 1);
+		vt100_write(row, sizeof(row));
 	}
+
+	vt100_goto(1, 1);
 #else
 	for (uint8_t y = 0 ; y < 64 ; y += 8)
 	{
@@ -79,6 +90,318 @@ fill_screen(void)
 }
 
 
+/** Hardware serial port receive queue.
+ *
+ * The size must be a power of two.  A scroll or a full repaint can
+ * keep the main loop away for several milliseconds, so the default
+ * uses a good part of the 8 KB of SRAM.  The head and tail count
+ * freely and are masked on use, so head - tail is always the number
+ * of bytes waiting, from empty (0) to full (RX_QUEUE_SIZE).
+ */
+#ifndef CONFIG_RX_QUEUE_SIZE
+#define CONFIG_RX_QUEUE_SIZE	1024
+#endif
+
+#define RX_QUEUE_SIZE	CONFIG_RX_QUEUE_SIZE
+#define RX_QUEUE_MASK	(RX_QUEUE_SIZE - 1)
+
+#if (RX_QUEUE_SIZE & RX_QUEUE_MASK) != 0 || RX_QUEUE_SIZE > 0x8000
+#error "CONFIG_RX_QUEUE_SIZE must be a power of two, up to 32 KB"
+#endif
+
+static volatile uint16_t rx_head; // where the next will be written
+static volatile uint16_t rx_tail; // where the next will be read
+static uint8_t rx_buf[RX_QUEUE_SIZE];
+
+/** Most bytes that have been waiting in the queue at once */
+static volatile uint16_t rx_high_water;
+
+/** Flow control watermarks.
+ *
+ * The host is told to stop when the queue is three quarters full,
+ * which leaves room for what is already on the wire, and to start
+ * again once the renderer has drained it to a quarter.
+ */
+#define RX_STOP_LEVEL	(RX_QUEUE_SIZE * 3 / 4)
+#define RX_START_LEVEL	(RX_QUEUE_SIZE / 4)
+
+#ifndef CONFIG_SERIAL_BAUD
+#define CONFIG_SERIAL_BAUD	115200
+#endif
+
+#define SERIAL_RXD	0xD2
+
+#ifdef CONFIG_SERIAL_RTS
+// Low when we can receive, the host's CTS input
+#define SERIAL_RTS	0xB4
+#else
+#define XON		0x11
+#define XOFF		0x13
+#endif
+
+static volatile uint8_t rx_stopped;
+
+#ifndef CONFIG_SERIAL_RTS
+/** XON or XOFF waiting for the transmitter, or 0 */
+static volatile uint8_t tx_flow;
+#endif
+
+/** Bytes lost, either in the UART or because the queue was full */
+static volatile uint16_t rx_overruns;
+
+
+/** Set the hardware serial port baud rate.
+ *
+ * Double speed mode divides the clock by 8 instead of 16, which
+ * makes 250k, 500k and 1M exact at 16 MHz and more than halves the
+ * error at 115.2k (UBRR 16 instead of 8).  Rates too slow for the
+ * 12-bit divider in double speed mode use normal mode.
+ */
+static void
+serial_baud(
+	const uint32_t baud
+)
+{
+	if (baud == 0)
+		return;
+
+	// Rounded F_CPU / (8 * baud) - 1
+	uint32_t ubrr = (F_CPU / 4 / baud - 1) / 2;
+	uint8_t u2x = 1;
+
+	if (ubrr > 0xFFF)
+	{
+		ubrr = (F_CPU / 8 / baud - 1) / 2;
+		u2x = 0;
+	}
+
+	// Let the last byte out before changing the clock
+	while (bit_is_clear(UCSR1A, UDRE1))
+		;
+
+	UCSR1A = u2x << U2X1;
+	UBRR1 = ubrr;
+}
+
+
+/** Send a byte on the hardware serial port.
+ *
+ * A waiting XON/XOFF goes first, so the check for room and the write
+ * must not be split.
+ */
+static void
+serial_putchar(
+	const uint8_t c
+)
+{
+	while (1)
+	{
+		const uint8_t sreg = SREG;
+		cli();
+
+#ifndef CONFIG_SERIAL_RTS
+		if (!tx_flow && bit_is_set(UCSR1A, UDRE1))
+#else
+		if (bit_is_set(UCSR1A, UDRE1))
+#endif
+		{
+			UDR1 = c;
+			SREG = sreg;
+			return;
+		}
+
+		SREG = sreg;
+	}
+}
+
+
+static void
+serial_flow(
+	const uint8_t stop
+)
+{
+	rx_stopped = stop;
+
+#ifdef CONFIG_SERIAL_RTS
+	out(SERIAL_RTS, stop);
+#else
+	// This runs in the receive interrupt or with interrupts off,
+	// so it must not wait for the transmitter.  The byte is sent
+	// from the data register empty interrupt; a newer one replaces
+	// one that has not gone out yet.
+	tx_flow = stop ? XOFF : XON;
+	sbi(UCSR1B, UDRIE1);
+#endif
+}
+
+
+#ifndef CONFIG_SERIAL_RTS
+ISR(USART1_UDRE_vect)
+{
+	cbi(UCSR1B, UDRIE1);
+
+	if (tx_flow)
+	{
+		UDR1 = tx_flow;
+		tx_flow = 0;
+	}
+}
+#endif
+
+
+ISR(USART1_RX_vect)
+{ 
+	// The data overrun flag must be read before the data
+	if (bit_is_set(UCSR1A, DOR1))
+		rx_overruns++;
+
+	const uint8_t c = UDR1;
+	const uint16_t head = rx_head;
+	const uint16_t used = head - rx_tail + 1;
+	if (used > RX_QUEUE_SIZE)
+	{
+		rx_overruns++;
+		return;
+	}
+
+	rx_buf[head & RX_QUEUE_MASK] = c;
+	rx_head = head + 1;
+
+	if (used > rx_high_water)
+		rx_high_water = used;
+
+	if (used >= RX_STOP_LEVEL && !rx_stopped)
+		serial_flow(1);
+}
+
+
+/** Copy up to max bytes out of the receive queue.
+ *
+ * Taking everything that is waiting at once lets the terminal work
+ * through a run of characters without going back to the queue.
+ *
+ * \return Number of bytes copied, 0 if none are waiting.
+ */
+static uint8_t
+serial_recv(
+	uint8_t * const buf,
+	const uint8_t max
+)
+{
+	// The 16-bit indices are shared with the interrupt handler
+	uint8_t sreg = SREG;
+	cli();
+	const uint16_t head = rx_head;
+	SREG = sreg;
+
+	uint16_t tail = rx_tail;
+	uint16_t n = head - tail;
+	if (n > max)
+		n = max;
+
+	for (uint8_t i = 0 ; i < n ; i++)
+		buf[i] = rx_buf[tail++ & RX_QUEUE_MASK];
+
+	sreg = SREG;
+	cli();
+	rx_tail = tail;
+	if (rx_stopped && (uint16_t)(rx_head - tail) <= RX_START_LEVEL)
+		serial_flow(0);
+	SREG = sreg;
+
+	return n;
+}
+
+
+// The statistics go on the bottom row of the current font, for a
+// couple of seconds, and then the row is redrawn from its cells.
+#define STATS_ROW	(LCD_HEIGHT / font_height - 1)
+#define STATS_TICKS	1000
+
+static uint16_t stats_ticks;
+
+
+/** Draw a string from flash directly on the LCD, bypassing the
+ * terminal's cells.
+ */
+static uint8_t
+draw_str(
+	uint8_t col,
+	const char * s
+)
+{
+	while (1)
+	{
+		const char c = pgm_read_byte(s++);
+		if (!c)
+			return col;
+		font_draw(col++, STATS_ROW, c, FONT_INVERSE);
+	}
+}
+
+
+static uint8_t
+draw_num(
+	uint8_t col,
+	uint16_t n
+)
+{
+	char buf[6];
+	uint8_t i = sizeof(buf);
+
+	do {
+		buf[--i] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+
+	while (i < sizeof(buf))
+		font_draw(col++, STATS_ROW, buf[i++], FONT_INVERSE);
+
+	return col;
+}
+
+
+/** Show the receive flow control statistics on the bottom line */
+static void
+show_stats(void)
+{
+	uint8_t col = 0;
+	stats_ticks = STATS_TICKS;
+#ifdef CONFIG_USB_SERIAL
+	col = draw_str(col, PSTR(" usb throttled "));
+	col = draw_num(col, usb_serial_throttled());
+#else
+	const uint8_t sreg = SREG;
+	cli();
+	const uint16_t overruns = rx_overruns;
+	const uint16_t high_water = rx_high_water;
+	SREG = sreg;
+
+	col = draw_str(col, PSTR(" rx overruns "));
+	col = draw_num(col, overruns);
+	col = draw_str(col, PSTR(" max "));
+	col = draw_num(col, high_water);
+#endif
+	draw_str(col, PSTR(" "));
+}
+
+
+/** Replies from the terminal go to the host the same way as keys */
+void
+vt100_reply(
+	const char * buf,
+	uint8_t n
+)
+{
+#ifdef CONFIG_USB_SERIAL
+	usb_serial_write((const uint8_t *) buf, n);
+#else
+	while (n--)
+		serial_putchar(*buf++);
+#endif
+}
+
+
 static void
 key_special(
 	const uint8_t key
@@ -87,8 +410,22 @@ key_special(
 	if (key == 0x81)
 	{
 		// f1 == redraw everything
-		vt100_clear();
-		vt100_goto(0, 0);
+		vt100_redraw();
+		return;
+	}
+
+	if (key == 0x83)
+	{
+		// f3 == switch between the 40x8 and 60x10 fonts; the
+		// host has to be told with stty or resize
+		vt100_font(font_height == 8 ? FONT_4X6 : FONT_6X8);
+		return;
+	}
+
+	if (key == 0x82)
+	{
+		// f2 == show dropped bytes for a couple of seconds
+		show_stats();
 		return;
 	}
 
@@ -104,30 +441,15 @@ key_special(
 
 
 
-/** Hardware serial port interrupt handler */
-#define RX_QUEUE_SIZE 128
-static volatile uint8_t rx_head; // where the next will be written
-static volatile uint8_t rx_tail; // where the next will be read
-static uint8_t rx_buf[RX_QUEUE_SIZE];
-
-ISR(USART1_RX_vect)
-{ 
-	char c = UDR1;
-	if (rx_head == rx_tail + RX_QUEUE_SIZE)
-		return;
-	rx_buf[rx_head++ % RX_QUEUE_SIZE] = c;
-}
-
+/** Timer 0 tick, 500 Hz.
+ *
+ * The main loop scans one keyboard column for each tick it sees.
+ */
+static volatile uint8_t ticks;
 
-int
-serial_getchar(void)
+ISR(TIMER0_COMPA_vect)
 {
-	uint8_t tail = rx_tail;
-	if (rx_head == tail)
-		return -1;
-	char c = rx_buf[tail % RX_QUEUE_SIZE];
-	rx_tail = tail + 1;
-	return c;
+	ticks++;
 }
 
 
@@ -147,22 +469,32 @@ main(void)
 	// without a PC connected to the USB port, this 
 	// will wait forever.
 	usb_init();
-#else
-	// We're not using USB, so setup the normal serial port
-	// 115.2k, n81, no interrupts
-	UBRR1 = 8; // 115.2k
+#endif
+
+	// The normal serial port is always available, n81 with
+	// a receive interrupt.  When USB is in use the host can
+	// change its baud rate with the CDC line coding.
+	// Keep RXD pulled up in case nothing is connected.
+	out(SERIAL_RXD, 1);
+	serial_baud(CONFIG_SERIAL_BAUD);
 	UCSR1B = (1 << RXEN1) | (1 << TXEN1) | (1 << RXCIE1);
 	UCSR1C = (0 << USBS1) | (3 << UCSZ10);
-	sei();
+
+#ifdef CONFIG_SERIAL_RTS
+	out(SERIAL_RTS, 0);
+	ddr(SERIAL_RTS, 1);
 #endif
+	sei();
 
 	// LED is an output; will be pulled down once connected
 	ddr(LED, 1);
 	out(LED, 1);
 
 	lcd_init();
+	vt100_init();
 
-        // Timer 0 is used for a 64 Hz control loop timer.
+        // Timer 0 is used for a 500 Hz control loop timer that
+        // scans the keyboard and paces the LCD frames.
         // Clk/256 == 62.5 KHz, count up to 125 == 500 Hz
         // Clk/1024 == 15.625 KHz, count up to 125 == 125 Hz
         // CTC mode resets the counter when it hits the top
@@ -175,11 +507,13 @@ main(void)
                 | 0 << WGM02
                 | 1 << CS02 // select Clk/256
                 | 0 << CS01
-                | 1 << CS00
+                | 0 << CS00
                 ;
 
-        OCR0A = 125;
+        OCR0A = 125; // KEY_TICK_HZ
         sbi(TIFR0, OCF0A); // reset the overflow bit
+        sbi(TIMSK0, OCIE0A); // interrupt on every tick
+        sei();
 
 #ifdef CONFIG_USB_SERIAL
 	while (!usb_configured())
@@ -202,28 +536,67 @@ main(void)
 
 	fill_screen();
 
-	uint8_t last_key = 0;
+	uint8_t last_frame = 0;
+	uint8_t last_key_tick = 0;
 
 	while (1)
 	{
+		uint8_t idle = 1;
+
 #ifdef CONFIG_USB_SERIAL
-		int c = usb_serial_getchar();
+		// Take a whole packet at a time from the endpoint
+		uint8_t buf[USB_SERIAL_RECV_SIZE];
+		const int8_t n = usb_serial_recv(buf);
+		if (n > 0)
+		{
+			vt100_write((const char *) buf, n);
+			idle = 0;
+		}
+
+		// Follow the rate that the host has asked for, once it
+		// has actually sent a line coding
+		uint32_t baud;
+		if (usb_serial_baud_changed(&baud))
+			serial_baud(baud);
 #else
-		int c = serial_getchar();
+		uint8_t buf[64];
 #endif
-		if (c != -1)
+
+		// Take everything waiting, a chunk at a time
+		const uint8_t len = serial_recv(buf, sizeof(buf));
+		if (len > 0)
 		{
-			vt100_putc(c);
+			vt100_write((const char *) buf, len);
+			idle = 0;
 		}
 
-		uint8_t key = keyboard_scan();
-		if (key == 0)
+		// Nothing waiting, catch the display up
+		if (idle)
+			lcd_flush();
+
+		// Scan the next keyboard column once a tick has passed.
+		// Ticks missed during a long redraw are dropped, since
+		// catching up would scan the sweeps back to back.
+		if (last_key_tick != ticks)
 		{
-			last_key = 0;
-		} else
-		if (key != last_key)
+			last_key_tick = ticks;
+			keyboard_tick();
+
+			// Take the statistics off the screen; the row
+			// could be unchanged in the cells, so the normal
+			// drawing would leave them there.
+			if (stats_ticks && --stats_ticks == 0)
+				vt100_redraw_row(STATS_ROW);
+		}
+
+		keyboard_event_t ev;
+		while (keyboard_event(&ev))
 		{
-			last_key = key;
+			const uint8_t key = keyboard_ascii(&ev);
+			if (key == 0)
+			{
+				// Release, or nothing to send
+			} else
 			if (key >= 0x80)
 			{
 				// Special char!
@@ -234,16 +607,19 @@ main(void)
 				usb_serial_putchar(key);
 #else
 				// Normal, send it serial
-				while (bit_is_clear(UCSR1A, UDRE1))
-					;
-				UDR1 = key;
+				serial_putchar(key);
 #endif
 			}
 		}
 
-		if (bit_is_clear(TIFR0, OCF0A))
+		// Frames are drawn at 125 Hz
+		if ((uint8_t)(ticks - last_frame) < 4)
 			continue;
 
-		sbi(TIFR0, OCF0A); // reset the bit
+		last_frame = ticks;
+
+		// Keep the display updating at the frame rate even if
+		// the host never pauses
+		lcd_flush();
 	}
 }
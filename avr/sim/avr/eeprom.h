@@ -0,0 +1,3 @@
+#ifndef _sim_avr_eeprom_h_
+#define _sim_avr_eeprom_h_
+#endif
@@ -0,0 +1,8 @@
+#ifndef _sim_avr_interrupt_h_
+#define _sim_avr_interrupt_h_
+
+#define ISR(vector)	void vector(void)
+#define sei()		do {} while (0)
+#define cli()		do {} while (0)
+
+#endif
@@ -0,0 +1,110 @@
+/** \file
+ * Host stand-in for the AVR register file.
+ *
+ * Every port register access goes through sim_reg() so that the
+ * HD44102 model can watch the bus one pin change at a time.
+ * Timer and UART registers are plain variables.
+ */
+#ifndef _sim_avr_io_h_
+#define _sim_avr_io_h_
+
+#include <stdint.h>
+
+enum {
+	SIM_PORTA, SIM_PORTB, SIM_PORTC, SIM_PORTD, SIM_PORTE, SIM_PORTF,
+	SIM_DDRA, SIM_DDRB, SIM_DDRC, SIM_DDRD, SIM_DDRE, SIM_DDRF,
+	SIM_PINA, SIM_PINB, SIM_PINC, SIM_PIND, SIM_PINE, SIM_PINF,
+	SIM_REGS
+};
+
+extern volatile uint8_t *
+sim_reg(
+	unsigned reg
+);
+
+#define PORTA	(*sim_reg(SIM_PORTA))
+#define PORTB	(*sim_reg(SIM_PORTB))
+#define PORTC	(*sim_reg(SIM_PORTC))
+#define PORTD	(*sim_reg(SIM_PORTD))
+#define PORTE	(*sim_reg(SIM_PORTE))
+#define PORTF	(*sim_reg(SIM_PORTF))
+#define DDRA	(*sim_reg(SIM_DDRA))
+#define DDRB	(*sim_reg(SIM_DDRB))
+#define DDRC	(*sim_reg(SIM_DDRC))
+#define DDRD	(*sim_reg(SIM_DDRD))
+#define DDRE	(*sim_reg(SIM_DDRE))
+#define DDRF	(*sim_reg(SIM_DDRF))
+#define PINA	(*sim_reg(SIM_PINA))
+#define PINB	(*sim_reg(SIM_PINB))
+#define PINC	(*sim_reg(SIM_PINC))
+#define PIND	(*sim_reg(SIM_PIND))
+#define PINE	(*sim_reg(SIM_PINE))
+#define PINF	(*sim_reg(SIM_PINF))
+
+extern volatile uint8_t sim_io[64];
+
+#define TCCR0A	sim_io[0]
+#define TCCR0B	sim_io[1]
+#define OCR0A	sim_io[2]
+#define TIFR0	sim_io[3]
+#define TIMSK0	sim_io[4]
+#define TCCR1A	sim_io[5]
+#define TCCR1B	sim_io[6]
+#define TCCR3A	sim_io[7]
+#define TCCR3B	sim_io[8]
+#define UCSR1A	sim_io[9]
+#define UCSR1B	sim_io[10]
+#define UCSR1C	sim_io[11]
+#define UDR1	sim_io[12]
+#define ADMUX	sim_io[13]
+#define CLKPR	sim_io[14]
+#define SREG	sim_io[15]
+
+extern volatile uint16_t sim_io16[8];
+
+#define OCR1B	sim_io16[0]
+#define OCR1C	sim_io16[1]
+#define UBRR1	sim_io16[2]
+
+/** Timer 3 counts CPU cycles as accounted by the bus model */
+extern uint16_t sim_tcnt3(void);
+#define TCNT3	(sim_tcnt3())
+
+#define WGM00	0
+#define WGM01	1
+#define WGM02	3
+#define CS00	0
+#define CS01	1
+#define CS02	2
+#define OCF0A	1
+#define OCIE0A	1
+#define WGM10	0
+#define WGM11	1
+#define WGM12	3
+#define WGM13	4
+#define COM1C0	2
+#define COM1C1	3
+#define COM1B0	4
+#define COM1B1	5
+#define CS10	0
+#define CS11	1
+#define CS12	2
+#define CS30	0
+#define CS31	1
+#define CS32	2
+#define RXEN1	4
+#define TXEN1	3
+#define RXCIE1	7
+#define UDRE1	5
+#define UDRIE1	5
+#define U2X1	1
+#define USBS1	3
+#define UCSZ10	1
+#define RXC1	7
+#define DOR1	3
+
+#define _BV(bit)		(1 << (bit))
+#define bit_is_set(sfr, bit)	((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit)	(!((sfr) & _BV(bit)))
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _sim_avr_pgmspace_h_
+#define _sim_avr_pgmspace_h_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)			(s)
+#define pgm_read_byte(p)	(*(const uint8_t *)(p))
+#define pgm_read_word(p)	(*(const uint16_t *)(p))
+#define pgm_read_ptr(p)		(*(void * const *)(p))
+#define memcpy_P		memcpy
+
+#endif
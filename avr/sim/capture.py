@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""
+Record the output of a program running on a 40x8 vt100 pseudo-terminal,
+for the replay benchmark corpus.
+
+    capture.py [-k keys] output command...
+
+Keystrokes are sent one at a time, each after the program has been
+quiet for a short while, so full screen programs see them the way
+they would from the Model 100 keyboard.  Python escapes are allowed
+in the keystroke string, and '~' pauses for a second (for top).
+"""
+import argparse
+import fcntl
+import os
+import pty
+import select
+import struct
+import sys
+import termios
+import time
+
+COLS = 40
+ROWS = 8
+
+
+def drain(fd, out, quiet):
+    """Read output until the program has been quiet for a while"""
+    while True:
+        r, _, _ = select.select([fd], [], [], quiet)
+        if not r:
+            return True
+        try:
+            data = os.read(fd, 4096)
+        except OSError:
+            return False
+        if not data:
+            return False
+        out.extend(data)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-k", "--keys", default="")
+    parser.add_argument("-q", "--quiet", type=float, default=0.2)
+    parser.add_argument("output")
+    parser.add_argument("command", nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    keys = args.keys.encode().decode("unicode_escape").encode("latin-1")
+
+    pid, fd = pty.fork()
+    if pid == 0:
+        os.environ["TERM"] = "vt100"
+        os.environ["LINES"] = str(ROWS)
+        os.environ["COLUMNS"] = str(COLS)
+        os.execvp(args.command[0], args.command)
+
+    fcntl.ioctl(fd, termios.TIOCSWINSZ, struct.pack("HHHH", ROWS, COLS, 0, 0))
+
+    out = bytearray()
+    alive = drain(fd, out, args.quiet)
+
+    for key in keys:
+        if not alive:
+            break
+        if key == ord("~"):
+            time.sleep(1)
+        else:
+            os.write(fd, bytes([key]))
+        alive = drain(fd, out, args.quiet)
+
+    while alive:
+        alive = drain(fd, out, args.quiet)
+
+    os.waitpid(pid, 0)
+
+    with open(args.output, "wb") as f:
+        f.write(out)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,231 @@
+/** \file
+ * Bit-level HD44102 bus model.
+ *
+ * Pin assignment matches avr/lcd.c:
+ *	PC0-7	data
+ *	PD4	RESET
+ *	PD5	CS1 (common)
+ *	PD7	R/!W
+ *	PE0	E
+ *	PE1	D/!I
+ *	PF0-7	CS20-CS27
+ *	PE6-7	CS28-CS29
+ *
+ * Every register access calls sim_sync() before it happens, so the
+ * model sees each intermediate pin state in order.
+ */
+#include <string.h>
+#include <avr/io.h>
+#include "hd44102.h"
+
+sim_stats_t sim_stats;
+unsigned sim_busy_cycles = 16; // 1 us at 16 MHz
+volatile uint8_t sim_io[64];
+volatile uint16_t sim_io16[8];
+
+static volatile uint8_t regs[SIM_REGS];
+static uint8_t last_en;
+static uint16_t last_cs;
+
+typedef struct
+{
+	uint8_t ram[4][50];
+	uint8_t page;
+	uint8_t col;
+	uint8_t start;
+	uint8_t up;
+	uint8_t on;
+	uint8_t out; // output register, loaded by each data read
+	uint64_t busy_until;
+} chip_t;
+
+static chip_t chips[SIM_CHIPS];
+
+
+static uint16_t
+selected(void)
+{
+	if (!(regs[SIM_PORTD] & (1 << 5)) || !(regs[SIM_PORTD] & (1 << 4)))
+		return 0;
+
+	return regs[SIM_PORTF] | (regs[SIM_PORTE] >> 6) << 8;
+}
+
+
+static void
+chip_advance(
+	chip_t * const c
+)
+{
+	if (c->up)
+		c->col = c->col == 49 ? 0 : c->col + 1;
+	else
+		c->col = c->col == 0 ? 49 : c->col - 1;
+}
+
+
+static void
+chip_command(
+	chip_t * const c,
+	const uint8_t byte
+)
+{
+	if (byte == 0x38 || byte == 0x39)
+		c->on = byte & 1;
+	else
+	if (byte == 0x3A || byte == 0x3B)
+		c->up = byte & 1;
+	else
+	if ((byte & 0x3F) == 0x3E)
+		c->start = byte >> 6;
+	else
+	if ((byte & 0x3F) < 50)
+	{
+		c->page = byte >> 6;
+		c->col = byte & 0x3F;
+	}
+}
+
+
+static void
+sim_sync(void)
+{
+	const uint8_t en = regs[SIM_PORTE] & 1;
+	const uint8_t rw = (regs[SIM_PORTD] >> 7) & 1;
+	const uint8_t di = (regs[SIM_PORTE] >> 1) & 1;
+	const uint16_t cs = selected();
+
+	for (unsigned i = 0 ; i < SIM_CHIPS ; i++)
+		if ((cs & ~last_cs) & (1 << i))
+			sim_stats.selects++;
+	last_cs = cs;
+
+	if (en && !last_en && cs && rw)
+	{
+		// rising edge in read mode: selected chips drive the bus
+		uint8_t bus = 0;
+		for (unsigned i = 0 ; i < SIM_CHIPS ; i++)
+		{
+			if (!(cs & (1 << i)))
+				continue;
+			chip_t * const c = &chips[i];
+			if (di)
+				bus |= c->out;
+			else
+				bus |= (sim_stats.cycles < c->busy_until) << 7
+					| !c->up << 6
+					| !c->on << 5;
+		}
+
+		regs[SIM_PINC] = bus;
+		if (di)
+			sim_stats.reads++;
+		else
+			sim_stats.status++;
+	} else
+	if (!en && last_en && cs)
+	{
+		// falling edge: latch writes, advance reads
+		const uint8_t byte = regs[SIM_PORTC] & regs[SIM_DDRC];
+		sim_stats.strobes++;
+
+		if (!rw && di)
+			sim_stats.writes++;
+		else
+		if (!rw)
+			sim_stats.commands++;
+
+		for (unsigned i = 0 ; i < SIM_CHIPS ; i++)
+		{
+			if (!(cs & (1 << i)))
+				continue;
+			chip_t * const c = &chips[i];
+
+			if (rw && di)
+			{
+				c->out = c->ram[c->page][c->col];
+				chip_advance(c);
+			} else
+			if (rw)
+			{
+				// status read, nothing changes
+				continue;
+			} else
+			if (di)
+			{
+				c->ram[c->page][c->col] = byte;
+				chip_advance(c);
+				sim_stats.chip_writes++;
+			} else
+				chip_command(c, byte);
+
+			c->busy_until = sim_stats.cycles + sim_busy_cycles;
+		}
+	}
+
+	if (!en || !rw)
+		regs[SIM_PINC] = regs[SIM_PORTC];
+
+	last_en = en;
+}
+
+
+volatile uint8_t *
+sim_reg(
+	unsigned reg
+)
+{
+	sim_sync();
+	sim_stats.cycles += 1;
+	return &regs[reg];
+}
+
+
+void
+sim_delay_cycles(
+	unsigned long cycles
+)
+{
+	sim_sync();
+	sim_stats.cycles += cycles;
+}
+
+
+uint16_t
+sim_tcnt3(void)
+{
+	return (uint16_t) sim_stats.cycles;
+}
+
+
+void
+sim_reset(void)
+{
+	memset(chips, 0, sizeof(chips));
+	memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+
+void
+sim_panel(
+	uint8_t panel[8][240]
+)
+{
+	for (unsigned y = 0 ; y < 64 ; y++)
+	{
+		const unsigned bank = y / 32;
+		const unsigned row = y % 32;
+
+		for (unsigned x = 0 ; x < 240 ; x++)
+		{
+			const chip_t * const c = &chips[bank * 5 + x / 50];
+			const unsigned phys = (row + 8 * c->start) % 32;
+			const uint8_t bit = (c->ram[phys / 8][x % 50] >> (phys % 8)) & 1;
+
+			if (bit)
+				panel[y / 8][x] |= 1 << (y % 8);
+			else
+				panel[y / 8][x] &= ~(1 << (y % 8));
+		}
+	}
+}
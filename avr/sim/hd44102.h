@@ -0,0 +1,46 @@
+/** \file
+ * Bit-level model of the ten HD44102 controllers on the Model 100.
+ *
+ * The model watches every port register access made by the AVR code
+ * and decodes enable strobes into commands, data writes and reads,
+ * counting each of them and the CPU cycles spent on the bus.
+ */
+#ifndef _sim_hd44102_h_
+#define _sim_hd44102_h_
+
+#include <stdint.h>
+
+#define SIM_CHIPS	10
+
+typedef struct
+{
+	uint64_t cycles; // CPU cycles: register accesses plus busy waits
+	uint64_t strobes; // enable strobes with at least one chip selected
+	uint64_t selects; // rising edges of the per-chip select lines
+	uint64_t commands; // instruction bytes latched
+	uint64_t writes; // data bytes latched
+	uint64_t reads; // data bytes driven onto the bus
+	uint64_t status; // status bytes driven onto the bus
+	uint64_t chip_writes; // data bytes stored, once per selected chip
+} sim_stats_t;
+
+extern sim_stats_t sim_stats;
+
+/** Number of cycles that the busy flag stays set after each transfer */
+extern unsigned sim_busy_cycles;
+
+
+/** Reset the controllers and the counters */
+extern void
+sim_reset(void);
+
+
+/** Render what is visible on the glass, in the same page/column
+ * layout as the AVR shadow framebuffer (LSB at the top).
+ */
+extern void
+sim_panel(
+	uint8_t panel[8][240]
+);
+
+#endif
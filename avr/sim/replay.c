@@ -0,0 +1,378 @@
+/** \file
+ * Replay captured byte streams through the terminal core and
+ * report the bus cost of each kind of operation.
+ *
+ * Each stream is run twice, each time on a freshly reset display.
+ * The first run flushes after every byte so that the cost of each
+ * byte can be charged to a printable character, a scroll, a clear
+ * or anything else (controls and escape sequences), and so that
+ * the worst case time from a byte arriving to it being on the glass
+ * is known.  The second run passes the input to vt100_write() in
+ * chunks of -f bytes and flushes after each, like the main loop does
+ * when input is arriving faster than the frame rate, and gives the
+ * totals.
+ *
+ * With -b one summary line is printed per stream, for comparing
+ * benchmark runs.  -F selects the font, 0 for 6x8 and 1 for 4x6;
+ * the streams were recorded for 40x8, so the small font only shows
+ * the cost of drawing off the page boundaries.
+ *
+ * All costs are in CPU cycles as seen by the bus model, which
+ * includes the busy waits but not the time spent parsing, so the
+ * characters per second are an upper bound set by the display.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "hd44102.h"
+#include "../lcd.h"
+#include "../font.h"
+#include "../vt100.h"
+
+enum {
+	OP_CHAR,
+	OP_SCROLL,
+	OP_CLEAR,
+	OP_OTHER,
+	OP_MAX,
+};
+
+static const char * const op_names[OP_MAX] = {
+	[OP_CHAR]	= "char",
+	[OP_SCROLL]	= "scroll",
+	[OP_CLEAR]	= "clear",
+	[OP_OTHER]	= "other",
+};
+
+/** Filled in by the passes, which run in child processes */
+typedef struct
+{
+	uint64_t count[OP_MAX];
+	uint64_t cycles[OP_MAX];
+	uint64_t worst; // most cycles for one byte
+	sim_stats_t bus;
+	lcd_stats_t lcd;
+} result_t;
+
+static result_t * result;
+static uint8_t font = FONT_6X8;
+static unsigned flush_every = 64; // bytes per chunk in run_total()
+
+
+/** Replies to the host are not part of the stream, so they go nowhere */
+void
+vt100_reply(
+	const char * buf,
+	uint8_t n
+)
+{
+	(void) buf;
+	(void) n;
+}
+
+
+static int
+check_panel(void)
+{
+	uint8_t panel[8][240];
+	uint8_t shadow[240];
+	sim_panel(panel);
+
+	for (uint8_t y = 0 ; y < 64 ; y += 8)
+	{
+		lcd_read(0, y, shadow, 240);
+		if (memcmp(shadow, panel[y / 8], 240) != 0)
+		{
+			fprintf(stderr, "panel and shadow differ on page %d\n", y / 8);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+static void
+start(void)
+{
+	sim_reset();
+	if (getenv("SIM_BUSY_CYCLES"))
+		sim_busy_cycles = strtoul(getenv("SIM_BUSY_CYCLES"), NULL, 0);
+
+	lcd_init();
+	vt100_init();
+	if (font != FONT_6X8)
+		vt100_font(font);
+
+	// Start counting after the power up delays
+	memset(&sim_stats, 0, sizeof(sim_stats));
+	memset(&lcd_stats, 0, sizeof(lcd_stats));
+}
+
+
+/** Flush after every byte and charge it to one kind of operation */
+static int
+run_ops(
+	const uint8_t * const buf,
+	const size_t len
+)
+{
+	start();
+
+	for (size_t i = 0 ; i < len ; i++)
+	{
+		const uint64_t before = sim_stats.cycles;
+		const uint32_t scrolls = lcd_stats.scrolls;
+		const uint32_t clears = lcd_stats.clears;
+
+		vt100_putc(buf[i]);
+		lcd_flush();
+
+		unsigned op;
+		if (lcd_stats.clears != clears)
+			op = OP_CLEAR;
+		else
+		if (lcd_stats.scrolls != scrolls)
+			op = OP_SCROLL;
+		else
+		if (0x20 <= buf[i] && buf[i] < 0x7F)
+			op = OP_CHAR;
+		else
+			op = OP_OTHER;
+
+		const uint64_t cycles = sim_stats.cycles - before;
+		result->cycles[op] += cycles;
+		result->count[op]++;
+		if (cycles > result->worst)
+			result->worst = cycles;
+	}
+
+	return check_panel();
+}
+
+
+/** Flush every few bytes and record the totals */
+static int
+run_total(
+	const uint8_t * const buf,
+	const size_t len
+)
+{
+	start();
+
+	// Input arrives in chunks, like the main loop
+	for (size_t i = 0 ; i < len ; i += flush_every)
+	{
+		const size_t n = len - i < flush_every ? len - i : flush_every;
+		vt100_write((const char *) &buf[i], n);
+		lcd_flush();
+	}
+
+	result->bus = sim_stats;
+	result->lcd = lcd_stats;
+
+	return check_panel();
+}
+
+
+/** Run one pass in a child so that every pass starts from reset */
+static int
+run(
+	int (*pass)(const uint8_t *, size_t),
+	const uint8_t * const buf,
+	const size_t len
+)
+{
+	fflush(stdout);
+
+	const pid_t pid = fork();
+	if (pid < 0)
+	{
+		perror("fork");
+		return -1;
+	}
+
+	if (pid == 0)
+		_exit(pass(buf, len) ? EXIT_FAILURE : EXIT_SUCCESS);
+
+	int status;
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+
+static void
+print_detail(
+	const char * const name,
+	const size_t len
+)
+{
+	const result_t * const r = result;
+
+	printf("%s:\n", name);
+
+	for (unsigned op = 0 ; op < OP_MAX ; op++)
+		printf("%-8s %10llu bytes %12llu cycles %10.1f cycles/byte\n",
+			op_names[op],
+			(unsigned long long) r->count[op],
+			(unsigned long long) r->cycles[op],
+			r->count[op] ? (double) r->cycles[op] / r->count[op] : 0.0
+		);
+
+	printf("%-8s %10zu bytes %12llu cycles %10.1f cycles/byte %8.1f ms\n",
+		"total",
+		len,
+		(unsigned long long) r->bus.cycles,
+		len ? (double) r->bus.cycles / len : 0.0,
+		r->bus.cycles * 1000.0 / F_CPU
+	);
+
+	printf("bus      cmd %llu wr %llu rd %llu st %llu sel %llu frames %lu scrolls %lu clears %lu busy %lu timeouts %lu\n",
+		(unsigned long long) r->bus.commands,
+		(unsigned long long) r->bus.writes,
+		(unsigned long long) r->bus.reads,
+		(unsigned long long) r->bus.status,
+		(unsigned long long) r->bus.selects,
+		(unsigned long) r->lcd.frames,
+		(unsigned long) r->lcd.scrolls,
+		(unsigned long) r->lcd.clears,
+		(unsigned long) r->lcd.busy,
+		(unsigned long) r->lcd.timeouts
+	);
+}
+
+
+static void
+print_summary(
+	const char * const name,
+	const size_t len
+)
+{
+	const result_t * const r = result;
+
+	printf("%-16s %8zu %10.0f %10.1f %10lu %10lu %10llu\n",
+		name,
+		len,
+		r->bus.cycles ? len * (double) F_CPU / r->bus.cycles : 0.0,
+		r->worst * 1.0e6 / F_CPU,
+		(unsigned long) r->lcd.write_calls,
+		(unsigned long) r->lcd.read_calls,
+		(unsigned long long) r->bus.writes
+	);
+}
+
+
+static int
+read_file(
+	const char * const name,
+	uint8_t ** const buf_out,
+	size_t * const len_out
+)
+{
+	FILE * const f = name ? fopen(name, "rb") : stdin;
+	if (!f)
+	{
+		perror(name);
+		return -1;
+	}
+
+	uint8_t * buf = NULL;
+	size_t len = 0;
+	size_t size = 0;
+	int c;
+
+	while ((c = getc(f)) != EOF)
+	{
+		if (len == size)
+		{
+			size = size ? size * 2 : 4096;
+			buf = realloc(buf, size);
+			if (!buf)
+			{
+				perror("realloc");
+				return -1;
+			}
+		}
+
+		buf[len++] = c;
+	}
+
+	if (f != stdin)
+		fclose(f);
+
+	*buf_out = buf;
+	*len_out = len;
+	return 0;
+}
+
+
+int
+main(
+	int argc,
+	char ** argv
+)
+{
+	int summary = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "bf:F:")) != -1)
+	{
+		if (opt == 'b')
+			summary = 1;
+		else
+		if (opt == 'f' && atoi(optarg) > 0 && atoi(optarg) < 256)
+			flush_every = atoi(optarg);
+		else
+		if (opt == 'F' && atoi(optarg) >= 0 && atoi(optarg) < FONT_COUNT)
+			font = atoi(optarg);
+		else {
+			fprintf(stderr, "usage: %s [-b] [-f flush-bytes] [-F font] [file...]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	result = mmap(NULL, sizeof(*result), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (result == MAP_FAILED)
+	{
+		perror("mmap");
+		return EXIT_FAILURE;
+	}
+
+	if (summary)
+		printf("%-16s %8s %10s %10s %10s %10s %10s\n",
+			"stream", "bytes", "chars/s", "worst us",
+			"lcd_write", "lcd_read", "bus wr");
+
+	int rc = 0;
+
+	for (int i = optind ; i < argc || i == optind ; i++)
+	{
+		const char * const name = i < argc ? argv[i] : NULL;
+		uint8_t * buf;
+		size_t len;
+		if (read_file(name, &buf, &len) < 0)
+			return EXIT_FAILURE;
+
+		memset(result, 0, sizeof(*result));
+		rc |= run(run_ops, buf, len);
+		rc |= run(run_total, buf, len);
+
+		const char * base = name ? strrchr(name, '/') : NULL;
+		base = base ? base + 1 : name ? name : "-";
+
+		if (summary)
+			print_summary(base, len);
+		else
+			print_detail(base, len);
+
+		free(buf);
+	}
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
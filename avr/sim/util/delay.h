@@ -0,0 +1,10 @@
+#ifndef _sim_util_delay_h_
+#define _sim_util_delay_h_
+
+/** Busy waits are accounted as CPU cycles by the bus model */
+extern void sim_delay_cycles(unsigned long cycles);
+
+#define _delay_us(us)	sim_delay_cycles((unsigned long)((us) * (F_CPU / 1000000UL)))
+#define _delay_ms(ms)	sim_delay_cycles((unsigned long)((ms) * (F_CPU / 1000UL)))
+
+#endif
@@ -0,0 +1,346 @@
+/** \file
+ * Checks of the terminal core against the bus model.
+ *
+ * Each case starts from a freshly reset 40x8 screen and feeds a
+ * string through vt100_write().  The cursor cases then ask for the
+ * cursor position with <ESC>[6n and the reply has to match exactly.
+ * The screen cases compare every cell of the screen model with the
+ * expected text and attributes.  After either kind, what the bus
+ * model shows on the glass has to match the LCD driver's shadow copy.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "hd44102.h"
+#include "../lcd.h"
+#include "../font.h"
+#include "../vt100.h"
+
+typedef struct
+{
+	const char * input;
+	const char * reply;
+} test_t;
+
+static const test_t tests[] = {
+	{ "\e[4;5H",			"\e[4;5R" },
+	{ "\e[H",			"\e[1;1R" },
+	{ "\e[0;0H",			"\e[1;1R" },
+
+	// Parameters that do not fit in 8 bits must not wrap
+	{ "\e[256;256H",		"\e[8;40R" },
+	{ "\e[257;257f",		"\e[8;40R" },
+	{ "\e[255E",			"\e[8;1R" },
+	{ "\e[5;5H\e[999F",		"\e[1;1R" },
+	{ "\e[3;1H\e[300G",		"\e[3;40R" },
+	{ "\e[3;1H\e[256`",		"\e[3;40R" },
+	{ "\e[2;2H\e[264d",		"\e[8;2R" },
+
+	// or 16 bits, they saturate
+	{ "\e[65536;1H",		"\e[8;1R" },
+	{ "\e[65537;65537H",		"\e[8;40R" },
+	{ "\e[99999999999999;3H",	"\e[8;3R" },
+	{ "\e[5;5H\e[65536F",		"\e[1;1R" },
+
+	// The saved cursor stays on a screen that gets smaller
+	{ "\e[8;10;60t\e[10;60H\e7\e[8;8;40t\e8x",	"\e[8;40R" },
+	{ "\e[8;10;60t\e[10;60H\e[s\e[8;8;40t\e[ux",	"\e[8;40R" },
+	{ "\e[8;10;60t\e[10;60H\e[?1049h\e[8;8;40t\e[?1049lx",	"\e[8;40R" },
+
+	// 1049 only saves and restores the cursor
+	{ "\e[2;3H\e[?1049h\e[6;7H\e[?1049l",	"\e[2;3R" },
+	{ "\e[2;3H\e[?1049h",		"\e[2;3R" },
+
+	// A clear after the controllers have scrolled
+	{ "1\r\n2\r\n3\r\n4\r\n5\r\n6\r\n7\r\n8\r\n9\r\n\e[2J", "\e[8;1R" },
+};
+
+
+/** The screen after the input, starting at the row first.
+ *
+ * The rows of text are separated by newlines, and attrs has the same
+ * layout with one hex digit of FONT_ attributes for each cell.  The
+ * cells that are not listed have to be blank and normal.
+ */
+typedef struct
+{
+	const char * input;
+	uint8_t first;
+	const char * text;
+	const char * attrs;
+} screen_test_t;
+
+static const screen_test_t screen_tests[] = {
+	// SGR with any number of parameters; bold is kept apart from
+	// underline, and 22 only turns off bold
+	{ "\e[0;1;7mA\e[mB\e[4mC\e[22mD\e[1;4mE\e[22mF\e[24;7mG\e[27mH",
+		0, "ABCDEFGH", "50226210" },
+	{ "\e[1;7;4mX\e[;7mY\e[7;27;4mZ", 0, "XYZ", "712" },
+
+	// ED from the cursor, to the cursor and all
+	{ "abc\r\ndef\r\nghi\e[2;2H\e[J", 0, "abc\nd", NULL },
+	{ "abc\r\ndef\r\nghi\e[2;2H\e[1J", 0, "\n  f\nghi", NULL },
+	{ "abc\r\ndef\r\nghi\e[2;2H\e[2J", 0, "", NULL },
+	{ "\e[7mab\e[2J", 0, "", NULL },
+
+	// EL the same way
+	{ "abcdef\e[1;3H\e[K", 0, "ab", NULL },
+	{ "abcdef\e[1;3H\e[1K", 0, "   def", NULL },
+	{ "abcdef\r\nxy\e[1;3H\e[2K", 0, "\nxy", NULL },
+
+	// CUP clamps to the screen, and 0 is the same as 1
+	{ "\e[5;5H\e[0;0HZ", 0, "Z", NULL },
+	{ "\e[99;99HX\e[99;1HY",
+		7, "Y                                      X", NULL },
+	{ "\e[3;5HX\e[65536;2HY", 2, "    X\n\n\n\n\n Y", NULL },
+
+	// OSC, DCS, SOS, PM and APC are skipped, controls and all,
+	// up to BEL or ST
+	{ "a\e]0;title\ab", 0, "ab", NULL },
+	{ "a\e]2;x\r\ny\e\\b", 0, "ab", NULL },
+	{ "a\eP1$r\e\\b", 0, "ab", NULL },
+	{ "a\eXsos\e\\b\e^pm\e\\c\e_apc\e\\d", 0, "abcd", NULL },
+
+	// Escapes with intermediates ignore their final character
+	{ "\e[2;2H\e7\e[3;3H\e#8x\e(0y", 2, "  xy", NULL },
+
+	// CAN and SUB abort any sequence
+	{ "a\e[31\x18" "b", 0, "ab", NULL },
+	{ "a\e[7\x1a;4mb", 0, "a;4mb", NULL },
+	{ "a\e]0;x\x18" "b", 0, "ab", NULL },
+	{ "a\e\x1a" "b", 0, "ab", NULL },
+};
+
+static char reply[32];
+static size_t reply_len;
+
+
+void
+vt100_reply(
+	const char * buf,
+	uint8_t n
+)
+{
+	if (reply_len + n > sizeof(reply) - 1)
+		n = sizeof(reply) - 1 - reply_len;
+	memcpy(&reply[reply_len], buf, n);
+	reply_len += n;
+	reply[reply_len] = '\0';
+}
+
+
+/** Make the escapes readable in the failure messages */
+static const char *
+show(
+	const char * s
+)
+{
+	static char buf[2][128];
+	static int which;
+	char * const out = buf[which ^= 1];
+	size_t len = 0;
+
+	for ( ; *s && len < sizeof(buf[0]) - 4 ; s++)
+	{
+		if (*s == '\e')
+		{
+			memcpy(&out[len], "ESC", 3);
+			len += 3;
+		} else
+			out[len++] = *s;
+	}
+
+	out[len] = '\0';
+	return out;
+}
+
+
+/** Compare the glass with the shadow copy, page by page */
+static int
+check_panel(void)
+{
+	uint8_t panel[8][240];
+	uint8_t shadow[240];
+
+	lcd_flush();
+	sim_panel(panel);
+
+	for (uint8_t y = 0 ; y < 64 ; y += 8)
+	{
+		lcd_read(0, y, shadow, 240);
+		if (memcmp(shadow, panel[y / 8], 240) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/** Compare every cell with a screen case.
+ *
+ * \return the number of cells that differ, after printing the first.
+ */
+static int
+check_screen(
+	const screen_test_t * const t
+)
+{
+	const char * text = t->text;
+	const char * attrs = t->attrs ? t->attrs : "";
+	int errors = 0;
+
+	for (uint8_t row = 0 ; row < 8 ; row++)
+	{
+		const int listed = row >= t->first;
+
+		for (uint8_t col = 0 ; col < 40 ; col++)
+		{
+			uint8_t c = ' ';
+			uint8_t mod = FONT_NORMAL;
+
+			if (listed && *text && *text != '\n')
+				c = *text++;
+			if (listed && *attrs && *attrs != '\n')
+				mod = *attrs++ - '0';
+
+			const uint16_t cell = vt100_cell(row, col);
+			if (cell == (mod << 8 | c))
+				continue;
+
+			if (errors++ == 0)
+				fprintf(stderr, "%s: %d,%d is '%c' %d, expected '%c' %d\n",
+					show(t->input), row, col,
+					cell & 0xFF, cell >> 8, c, mod);
+		}
+
+		if (listed && *text == '\n')
+			text++;
+		if (listed && *attrs == '\n')
+			attrs++;
+	}
+
+	return errors;
+}
+
+
+/** Start from a reset screen and send the input */
+static void
+start(
+	const char * const input
+)
+{
+	sim_reset();
+	lcd_init();
+	vt100_init();
+
+	vt100_write(input, strlen(input));
+}
+
+
+/** Check the panel after a case, and count it as one more failure */
+static int
+panel_failures(
+	const char * const input
+)
+{
+	if (check_panel() == 0)
+		return 0;
+
+	fprintf(stderr, "%s: panel and shadow differ\n", show(input));
+	return 1;
+}
+
+
+static int
+cursor_case(
+	size_t i
+)
+{
+	const test_t * const t = &tests[i];
+	int failures = 0;
+
+	start(t->input);
+	reply_len = 0;
+	reply[0] = '\0';
+	vt100_write("\e[6n", 4);
+
+	if (strcmp(reply, t->reply) != 0)
+	{
+		fprintf(stderr, "%s: got %s, expected %s\n",
+			show(t->input), show(reply), show(t->reply));
+		failures++;
+	}
+
+	return failures + panel_failures(t->input);
+}
+
+
+static int
+screen_case(
+	size_t i
+)
+{
+	const screen_test_t * const t = &screen_tests[i];
+
+	start(t->input);
+
+	return (check_screen(t) != 0) + panel_failures(t->input);
+}
+
+
+/** Run one case in a child, so that every case starts from reset.
+ *
+ * \return 1 if it failed.
+ */
+static int
+run(
+	int (*test_case)(size_t),
+	size_t i
+)
+{
+	fflush(stderr);
+
+	const pid_t pid = fork();
+	if (pid < 0)
+	{
+		perror("fork");
+		return 1;
+	}
+
+	if (pid == 0)
+		_exit(test_case(i) != 0);
+
+	int status;
+	if (waitpid(pid, &status, 0) < 0)
+	{
+		perror("waitpid");
+		return 1;
+	}
+
+	return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+
+int
+main(void)
+{
+	const size_t num_tests = sizeof(tests) / sizeof(*tests);
+	const size_t num_screen = sizeof(screen_tests) / sizeof(*screen_tests);
+	int failures = 0;
+
+	for (size_t i = 0 ; i < num_tests ; i++)
+		failures += run(cursor_case, i);
+
+	for (size_t i = 0 ; i < num_screen ; i++)
+		failures += run(screen_case, i);
+
+	if (failures)
+	{
+		fprintf(stderr, "%d failures\n", failures);
+		return 1;
+	}
+
+	printf("vt100_test: %zu passed\n", num_tests + num_screen);
+	return 0;
+}
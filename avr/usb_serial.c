@@ -33,6 +33,7 @@
 #define USB_SERIAL_PRIVATE_INCLUDE
 #include "usb_serial.h"
 
+#include <string.h>
 #include <usb.h>
 
 
@@ -335,11 +336,18 @@ static volatile uint8_t usb_configuration=0;
 static volatile uint8_t transmit_flush_timer=0;
 static uint8_t transmit_previous_timeout=0;
 
+// reads that found the receive endpoint had sent the host a NAK
+static uint16_t rx_throttled=0;
+
 // serial port settings (baud rate, control signals, etc) set
 // by the PC.  These are ignored, but kept in RAM.
 static uint8_t cdc_line_coding[7]={0x00, 0xE1, 0x00, 0x00, 0x00, 0x00, 0x08};
 static uint8_t cdc_line_rtsdtr=0;
 
+// set when the host sends SET_LINE_CODING, cleared when the
+// new rate is read with usb_serial_baud_changed()
+static volatile uint8_t cdc_line_coding_changed=0;
+
 
 /**************************************************************************
  *
@@ -439,9 +447,21 @@ void usb_serial_flush_input(void)
 }
 
 
-#if 0
+// number of reads that found the host had been sent a NAK
+uint16_t usb_serial_throttled(void)
+{
+	return rx_throttled;
+}
+
+
 /**
- * Copy the receive buffer into a user space array, of at least 64 bytes.
+ * Copy the receive buffer into a user space array, of at least
+ * USB_SERIAL_RECV_SIZE bytes.
+ *
+ * The whole endpoint bank is copied in one critical section and
+ * then released to the host, instead of one byte per call as with
+ * usb_serial_getchar().  If usb_serial_getchar() has already taken
+ * part of the packet then only the rest of it is returned.
  *
  * \return Number of bytes copied in this packet, 0 if none, -1 on error.
  */
@@ -461,31 +481,44 @@ usb_serial_recv(
 		return -1;
 	}
 
-	int offset = 0;
-
 	UENUM = CDC_RX_ENDPOINT;
+
+	// Both banks stay full until the main loop reads them, so
+	// the host is sent NAKs and waits rather than losing data.
+	// Count the reads that find it was held off.
+	if (UEINTX & (1 << NAKOUTI))
+	{
+		UEINTX = ~(1 << NAKOUTI);
+		rx_throttled++;
+	}
+
 	while (1)
 	{
-		if (bit_is_clear(UEINTX, RWAL))
+		const uint8_t intr = UEINTX;
+		if (intr & (1 << RWAL))
+			break;
+
+		// No data in the buffer.  A zero length packet still
+		// has to be released before the next bank can be seen.
+		if (!(intr & (1 << RXOUTI)))
 		{
-			// No data in the buffer .
-			if (bit_is_clear(UEINTX, RXOUTI))
-			{
-				UEINTX = 0x6B;
-				goto retry;
-			}	
 			SREG = intr_state;
-			return -1;
+			return 0;
 		}
 
-		// take one byte out of the buffer
-		c = UEDATX;
-		// if buffer completely used, release it
-	if (!(UEINTX & (1<<RWAL))) UEINTX = 0x6B;
+		UEINTX = 0x6B;
+	}
+
+	// The byte count is what is left to read in this bank
+	const uint8_t n = UEBCLX;
+	for (uint8_t i = 0 ; i < n ; i++)
+		buf[i] = UEDATX;
+
+	// release the bank so the host can send the next packet
+	UEINTX = 0x6B;
 	SREG = intr_state;
-	return c;
+	return n;
 }
-#endif
 
 // transmit a character.  0 returned on success, -1 on error
 int8_t usb_serial_putchar(uint8_t c)
@@ -729,7 +762,33 @@ void usb_serial_flush_output(void)
 // communication
 uint32_t usb_serial_get_baud(void)
 {
-	return *(uint32_t *)cdc_line_coding;
+	uint32_t baud;
+	uint8_t intr_state;
+
+	// the control endpoint interrupt may be writing it
+	intr_state = SREG;
+	cli();
+	memcpy(&baud, cdc_line_coding, sizeof(baud));
+	SREG = intr_state;
+	return baud;
+}
+
+// returns 1 and the new rate if the host has set the line coding
+// since the last call, 0 otherwise.  The initial line coding is
+// only a placeholder, so nothing is reported until the host sets it.
+uint8_t usb_serial_baud_changed(uint32_t *baud)
+{
+	uint8_t intr_state, changed;
+
+	intr_state = SREG;
+	cli();
+	changed = cdc_line_coding_changed;
+	if (changed) {
+		memcpy(baud, cdc_line_coding, sizeof(*baud));
+		cdc_line_coding_changed = 0;
+	}
+	SREG = intr_state;
+	return changed;
 }
 uint8_t usb_serial_get_stopbits(void)
 {
@@ -969,6 +1028,7 @@ ISR(USB_COM_vect)
 			for (i=0; i<7; i++) {
 				*p++ = UEDATX;
 			}
+			cdc_line_coding_changed = 1;
 			usb_ack_out();
 			usb_send_in();
 			return;
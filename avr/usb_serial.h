@@ -11,6 +11,11 @@ uint8_t usb_configured(void);		// is the USB port configured
 int16_t usb_serial_getchar(void);	// receive a character (-1 if timeout/error)
 uint8_t usb_serial_available(void);	// number of bytes in receive buffer
 void usb_serial_flush_input(void);	// discard any buffered input
+int8_t usb_serial_recv(uint8_t *buf);	// receive a packet (0 if none, -1 if error)
+uint16_t usb_serial_throttled(void);	// times the host was held off by a full buffer
+
+// usb_serial_recv() buffers must hold an entire packet
+#define USB_SERIAL_RECV_SIZE		64
 
 // transmitting data
 int8_t usb_serial_putchar(uint8_t c);	// transmit a character
@@ -20,6 +25,7 @@ void usb_serial_flush_output(void);	// immediately transmit any buffered output
 
 // serial parameters
 uint32_t usb_serial_get_baud(void);	// get the baud rate
+uint8_t usb_serial_baud_changed(uint32_t *baud); // new rate from the host
 uint8_t usb_serial_get_stopbits(void);	// get the number of stop bits
 uint8_t usb_serial_get_paritytype(void);// get the parity type
 uint8_t usb_serial_get_numbits(void);	// get the number of data bits
@@ -1,9 +1,11 @@
 /**
  * \file VT100-like emulation.
  *
- * This implements a very simplistic VT100 emulator.
- * Not very many of the functions are implemented; just enough to
- * run vi and lynx, etc.
+ * This implements a VT100 emulator with an ECMA-48 escape sequence
+ * parser in the style of the well known DEC state machine by Paul
+ * Williams.  Not every function is implemented, but every sequence
+ * is parsed completely so that unknown ones are skipped cleanly
+ * instead of leaking characters onto the screen.
  */
 
 #include <avr/io.h>
@@ -16,39 +18,387 @@
 #include "vt100.h"
 #include "lcd.h"
 #include "font.h"
+#include "keyboard.h"
 
 
-// These might change if we use a smaller font.
-#define MAX_COLS 40
-#define MAX_ROWS 8
+// Largest screen in character cells, by default as many of the
+// smallest font as fit.  The current size follows the font.
+#ifndef MAX_COLS
+#define MAX_COLS	(LCD_WIDTH / FONT_MIN_WIDTH)
+#endif
+#ifndef MAX_ROWS
+#define MAX_ROWS	(LCD_HEIGHT / FONT_MIN_HEIGHT)
+#endif
+
+// Parser limits
+#define VT100_MAX_PARAMS	16
+#define VT100_MAX_INTERMEDIATES	2
+#define VT100_MAX_PARAM		9999
+
+static uint8_t num_cols;
+static uint8_t num_rows;
 
 static uint8_t cur_col;
 static uint8_t cur_row;
-static uint8_t vt100_state;
+static uint8_t wrap_pending;
 static uint8_t font_mod;
 
+// Scroll region, inclusive
+static uint8_t scroll_top;
+static uint8_t scroll_bottom;
+
+static uint8_t saved_col;
+static uint8_t saved_row;
+static uint8_t saved_mod;
+
+#ifdef CONFIG_FONT_8BIT
+/** Character sets designated as G0 and G1, and the one shifted in.
+ *
+ * Only ASCII and the DEC special graphics are known.  The graphics
+ * replace 0x5F to 0x7E with the line drawing glyphs, which the font
+ * keeps at 0x80 to 0x9F.
+ */
+static uint8_t charset_graphics[2];
+static uint8_t charset_shift;
+static uint8_t graphics;
+
+#define GRAPHICS_FIRST	0x5F
+#define GRAPHICS_LAST	0x7E
+#define GRAPHICS_FONT	0x80
+#else
+#define graphics	0
+#endif
+
+/** What is on the screen, one character and attribute per cell.
+ *
+ * Everything drawn goes through here, so cells that are rewritten
+ * with the same contents are never sent to the display and the
+ * whole screen can be redrawn without the host.
+ */
+typedef struct
+{
+	uint8_t c;
+	uint8_t mod;
+} vt100_cell_t;
+
+static vt100_cell_t cells[MAX_ROWS][MAX_COLS];
+
+/** Rows of cells line up with the 8 pixel display pages, so they can
+ * be moved in the LCD shadow copy and scrolled by the controllers.
+ */
+#define ROWS_ON_PAGES	(font_height == 8)
+
+
+/** Parser states */
+enum {
+	STATE_GROUND,
+	STATE_ESCAPE,
+	STATE_ESCAPE_INTERMEDIATE,
+	STATE_CSI_ENTRY,
+	STATE_CSI_PARAM,
+	STATE_CSI_INTERMEDIATE,
+	STATE_CSI_IGNORE,
+	STATE_STRING, // OSC, DCS, SOS, PM and APC are all ignored
+};
+
+/** Parser actions */
+enum {
+	ACTION_NONE,
+	ACTION_IGNORE,
+	ACTION_PRINT,
+	ACTION_EXECUTE,
+	ACTION_CLEAR,
+	ACTION_COLLECT,
+	ACTION_PARAM,
+	ACTION_ESC_DISPATCH,
+	ACTION_CSI_DISPATCH,
+};
+
+typedef struct
+{
+	uint8_t lo;
+	uint8_t hi;
+	uint8_t action;
+	uint8_t next;
+} vt100_transition_t;
+
+#define T(lo, hi, action, next) \
+	{ lo, hi, ACTION_ ## action, STATE_ ## next }
+
+// Every state executes the C0 controls without changing state
+#define C0_EXECUTE(state) \
+	T(0x00, 0x17, EXECUTE, state), \
+	T(0x19, 0x19, EXECUTE, state), \
+	T(0x1C, 0x1F, EXECUTE, state)
+
+/** Transitions for each state, checked in order.
+ *
+ * CAN, SUB and ESC are handled before the table is consulted,
+ * since they are the same from any state.  Each state ends with a
+ * catch-all entry so the search always terminates.
+ */
+static const vt100_transition_t vt100_transitions[] PROGMEM =
+{
+#define GROUND_START 0
+	C0_EXECUTE(GROUND),
+	T(0x20, 0x7E, PRINT, GROUND),
+	T(0x00, 0xFF, IGNORE, GROUND), // DEL and 8-bit characters
+
+#define ESCAPE_START (GROUND_START + 5)
+	C0_EXECUTE(ESCAPE),
+	T(0x20, 0x2F, COLLECT, ESCAPE_INTERMEDIATE),
+	T(0x5B, 0x5B, CLEAR, CSI_ENTRY), // [
+	T(0x5D, 0x5D, NONE, STRING), // ] OSC
+	T(0x50, 0x50, NONE, STRING), // P DCS
+	T(0x58, 0x58, NONE, STRING), // X SOS
+	T(0x5E, 0x5F, NONE, STRING), // ^ PM, _ APC
+	T(0x30, 0x7E, ESC_DISPATCH, GROUND),
+	T(0x00, 0xFF, IGNORE, ESCAPE),
+
+#define ESCAPE_INTERMEDIATE_START (ESCAPE_START + 11)
+	C0_EXECUTE(ESCAPE_INTERMEDIATE),
+	T(0x20, 0x2F, COLLECT, ESCAPE_INTERMEDIATE),
+	T(0x30, 0x7E, ESC_DISPATCH, GROUND),
+	T(0x00, 0xFF, IGNORE, ESCAPE_INTERMEDIATE),
+
+#define CSI_ENTRY_START (ESCAPE_INTERMEDIATE_START + 6)
+	C0_EXECUTE(CSI_ENTRY),
+	T(0x20, 0x2F, COLLECT, CSI_INTERMEDIATE),
+	T(0x3A, 0x3A, NONE, CSI_IGNORE),
+	T(0x30, 0x3B, PARAM, CSI_PARAM),
+	T(0x3C, 0x3F, COLLECT, CSI_PARAM), // private marker
+	T(0x40, 0x7E, CSI_DISPATCH, GROUND),
+	T(0x00, 0xFF, IGNORE, CSI_ENTRY),
+
+#define CSI_PARAM_START (CSI_ENTRY_START + 9)
+	C0_EXECUTE(CSI_PARAM),
+	T(0x3A, 0x3A, NONE, CSI_IGNORE),
+	T(0x30, 0x3B, PARAM, CSI_PARAM),
+	T(0x3C, 0x3F, NONE, CSI_IGNORE),
+	T(0x20, 0x2F, COLLECT, CSI_INTERMEDIATE),
+	T(0x40, 0x7E, CSI_DISPATCH, GROUND),
+	T(0x00, 0xFF, IGNORE, CSI_PARAM),
+
+#define CSI_INTERMEDIATE_START (CSI_PARAM_START + 9)
+	C0_EXECUTE(CSI_INTERMEDIATE),
+	T(0x20, 0x2F, COLLECT, CSI_INTERMEDIATE),
+	T(0x30, 0x3F, NONE, CSI_IGNORE),
+	T(0x40, 0x7E, CSI_DISPATCH, GROUND),
+	T(0x00, 0xFF, IGNORE, CSI_INTERMEDIATE),
+
+#define CSI_IGNORE_START (CSI_INTERMEDIATE_START + 7)
+	C0_EXECUTE(CSI_IGNORE),
+	T(0x40, 0x7E, NONE, GROUND),
+	T(0x00, 0xFF, IGNORE, CSI_IGNORE),
+
+#define STRING_START (CSI_IGNORE_START + 5)
+	T(0x07, 0x07, NONE, GROUND), // BEL ends an xterm OSC
+	T(0x00, 0xFF, IGNORE, STRING),
+};
+
+/** Index of the first transition for each state */
+static const uint8_t vt100_state_start[] PROGMEM =
+{
+	[STATE_GROUND]			= GROUND_START,
+	[STATE_ESCAPE]			= ESCAPE_START,
+	[STATE_ESCAPE_INTERMEDIATE]	= ESCAPE_INTERMEDIATE_START,
+	[STATE_CSI_ENTRY]		= CSI_ENTRY_START,
+	[STATE_CSI_PARAM]		= CSI_PARAM_START,
+	[STATE_CSI_INTERMEDIATE]	= CSI_INTERMEDIATE_START,
+	[STATE_CSI_IGNORE]		= CSI_IGNORE_START,
+	[STATE_STRING]			= STRING_START,
+};
+
+static uint8_t vt100_state;
+static uint16_t params[VT100_MAX_PARAMS];
+static uint8_t num_params;
+static uint8_t intermediates[VT100_MAX_INTERMEDIATES];
+static uint8_t num_intermediates;
+static uint8_t private_marker;
+
+
+/** Size the screen to the current font, and blank the cells that
+ * fall outside it so that they are empty if it grows again.
+ */
+static void
+vt100_geometry(void)
+{
+	num_cols = LCD_WIDTH / font_width;
+	num_rows = LCD_HEIGHT / font_height;
+	if (num_cols > MAX_COLS)
+		num_cols = MAX_COLS;
+	if (num_rows > MAX_ROWS)
+		num_rows = MAX_ROWS;
+
+	for (uint8_t y = 0 ; y < MAX_ROWS ; y++)
+	{
+		for (uint8_t x = 0 ; x < MAX_COLS ; x++)
+		{
+			if (y < num_rows && x < num_cols)
+				continue;
+
+			cells[y][x].c = ' ';
+			cells[y][x].mod = FONT_NORMAL;
+		}
+	}
+
+	if (cur_row >= num_rows)
+		cur_row = num_rows - 1;
+	if (cur_col >= num_cols)
+		cur_col = num_cols - 1;
+	wrap_pending = 0;
+
+	// and the saved one, which ESC 8, CSI u and 1049 restore
+	// without checking
+	if (saved_row >= num_rows)
+		saved_row = num_rows - 1;
+	if (saved_col >= num_cols)
+		saved_col = num_cols - 1;
+
+	scroll_top = 0;
+	scroll_bottom = num_rows - 1;
+}
+
+
+/** Draw the cells [start,end) of a row from the cell contents.
+ *
+ * Each run of cells with the same attributes is one font_draw_run(),
+ * and the LCD driver only sends the columns that change.
+ */
+static void
+vt100_draw(
+	uint8_t row,
+	uint8_t start,
+	uint8_t end
+)
+{
+	char buf[MAX_COLS];
+
+	while (start < end)
+	{
+		const uint8_t mod = cells[row][start].mod;
+		uint8_t n = 0;
+
+		do {
+			buf[n] = cells[row][start + n].c;
+			n++;
+		} while (start + n < end && cells[row][start + n].mod == mod);
+
+		font_draw_run(start, row, buf, n, mod);
+		start += n;
+	}
+}
+
+
+void
+vt100_init(void)
+{
+	for (uint8_t y = 0 ; y < MAX_ROWS ; y++)
+	{
+		for (uint8_t x = 0 ; x < MAX_COLS ; x++)
+		{
+			cells[y][x].c = ' ';
+			cells[y][x].mod = FONT_NORMAL;
+		}
+	}
+
+	vt100_geometry();
+
+	// The display RAM is random at power up
+	lcd_clear();
+}
+
+
+void
+vt100_font(
+	uint8_t font
+)
+{
+	font_select(font);
+	vt100_geometry();
+
+	// Nothing lines up with the old cells, so start from blank
+	lcd_clear();
+	for (uint8_t y = 0 ; y < num_rows ; y++)
+		vt100_draw(y, 0, num_cols);
+}
+
+
 void
 vt100_clear(void)
 {
-	for (uint8_t j = 0 ; j < 8 ; j++)
-		for (uint8_t i = 0 ; i < 40 ; i++)
-			font_draw(i, j, ' ', FONT_NORMAL);
+	// Nothing to do if the screen is already blank, which is
+	// common when programs clear it before drawing.
+	uint8_t blank = 1;
+
+	for (uint8_t y = 0 ; y < num_rows ; y++)
+	{
+		for (uint8_t x = 0 ; x < num_cols ; x++)
+		{
+			vt100_cell_t * const cell = &cells[y][x];
+			if (cell->c == ' ' && cell->mod == FONT_NORMAL)
+				continue;
+
+			cell->c = ' ';
+			cell->mod = FONT_NORMAL;
+			blank = 0;
+		}
+	}
+
+	if (!blank)
+		lcd_clear();
+}
+
+
+void
+vt100_redraw_row(
+	uint8_t row
+)
+{
+	if (row < num_rows)
+		vt100_draw(row, 0, num_cols);
+}
+
+
+void
+vt100_redraw(void)
+{
+	for (uint8_t y = 0 ; y < num_rows ; y++)
+		vt100_draw(y, 0, num_cols);
+
+	lcd_refresh();
+}
+
+
+uint16_t
+vt100_cell(
+	uint8_t row,
+	uint8_t col
+)
+{
+	if (row >= num_rows || col >= num_cols)
+		return 0;
+
+	const vt100_cell_t * const cell = &cells[row][col];
+	return cell->mod << 8 | cell->c;
 }
 
 
 void
 vt100_goto(
-	uint8_t new_row,
-	uint8_t new_col
+	uint16_t new_row,
+	uint16_t new_col
 )
 {
+	// Clamp while the values are still 16 bits wide
+	if (new_row > num_rows)
+		new_row = num_rows;
+	if (new_col > num_cols)
+		new_col = num_cols;
+
 	cur_row = new_row > 0 ? new_row - 1 : 0;
 	cur_col = new_col > 0 ? new_col - 1 : 0;
-
-	if (cur_row >= MAX_ROWS)
-		cur_row = MAX_ROWS - 1;
-	if (cur_col >= MAX_COLS)
-		cur_col = MAX_COLS - 1;
+	wrap_pending = 0;
 }
 
 
@@ -59,152 +409,729 @@ buzzer(void)
 }
 
 
+/** Draw one character cell, unless it already has those contents */
 static void
-vt100_process(
-	char c
+vt100_set(
+	uint8_t row,
+	uint8_t col,
+	uint8_t c,
+	uint8_t mod
+)
+{
+	vt100_cell_t * const cell = &cells[row][col];
+	if (cell->c == c && cell->mod == mod)
+		return;
+
+	cell->c = c;
+	cell->mod = mod;
+	font_draw(col, row, c, mod);
+}
+
+
+/** Blank the columns [start,end) of a row */
+static void
+vt100_erase(
+	uint8_t row,
+	uint8_t start,
+	uint8_t end
 )
 {
-	static uint8_t arg1;
-	static uint8_t arg2;
-	static uint8_t vt100_query;
+	// Only the span between the first and last cells that are
+	// not already blank needs to be filled.
+	uint8_t first = end;
+	uint8_t last = start;
 
-	if (vt100_state == 1)
+	for (uint8_t x = start ; x < end ; x++)
 	{
-		arg1 = arg2 = 0;
-		vt100_query = 0;
+		vt100_cell_t * const cell = &cells[row][x];
+		if (cell->c == ' ' && cell->mod == FONT_NORMAL)
+			continue;
 
-		if (c == 'c')
-		{
-			vt100_clear();
-			cur_row = cur_col = 0;
-		} else
-		if (c == '[')
-		{
-			vt100_state = 2;
-			return;
-		} else
-		if (c == '(' || c == ')')
+		cell->c = ' ';
+		cell->mod = FONT_NORMAL;
+		if (x < first)
+			first = x;
+		last = x + 1;
+	}
+
+	if (first >= last)
+		return;
+
+	font_draw_run(first, row, NULL, last - first, FONT_NORMAL);
+}
+
+
+/** Move a row of cells and their pixels */
+static void
+vt100_move_row(
+	uint8_t dst,
+	uint8_t src
+)
+{
+	memcpy(cells[dst], cells[src], sizeof(cells[dst]));
+
+	if (!ROWS_ON_PAGES)
+	{
+		vt100_draw(dst, 0, num_cols);
+		return;
+	}
+
+	lcd_move(
+		0, dst * font_height,
+		0, src * font_height,
+		num_cols * font_width
+	);
+}
+
+
+/** Move n cells and their pixels within a row */
+static void
+vt100_move_cells(
+	uint8_t row,
+	uint8_t dst,
+	uint8_t src,
+	uint8_t n
+)
+{
+	memmove(&cells[row][dst], &cells[row][src], n * sizeof(vt100_cell_t));
+
+	if (!ROWS_ON_PAGES)
+	{
+		vt100_draw(row, dst, dst + n);
+		return;
+	}
+
+	lcd_move(
+		dst * font_width, row * font_height,
+		src * font_width, row * font_height,
+		n * font_width
+	);
+}
+
+
+/** Scroll rows top to bottom (inclusive) up by n, blanking the bottom */
+static void
+vt100_scroll_up(
+	uint8_t top,
+	uint8_t bottom,
+	uint16_t count
+)
+{
+	const uint8_t rows = bottom - top + 1;
+	uint8_t n = count < rows ? count : rows;
+
+	if (ROWS_ON_PAGES && top == 0 && bottom == num_rows - 1 && n < rows)
+	{
+		// The whole screen scrolls with the controllers'
+		// start page, which is nearly free.
+		memmove(cells[0], cells[n], (num_rows - n) * sizeof(cells[0]));
+		for (uint8_t y = num_rows - n ; y < num_rows ; y++)
 		{
-			// We mostly ignore these
-			vt100_state = 10;
-			return;
+			for (uint8_t x = 0 ; x < num_cols ; x++)
+			{
+				cells[y][x].c = ' ';
+				cells[y][x].mod = FONT_NORMAL;
+			}
 		}
+
+		while (n--)
+			lcd_scroll();
+		return;
+	}
+
+	// Otherwise it is a blit in the LCD shadow copy, or a redraw
+	// if the rows are not on page boundaries; either way only the
+	// columns that change are sent to the display.
+	for (uint8_t y = top ; y + n <= bottom ; y++)
+		vt100_move_row(y, y + n);
+
+	for (uint8_t y = bottom + 1 - n ; y <= bottom ; y++)
+		vt100_erase(y, 0, num_cols);
+}
+
+
+/** Scroll rows top to bottom (inclusive) down by n, blanking the top */
+static void
+vt100_scroll_down(
+	uint8_t top,
+	uint8_t bottom,
+	uint16_t count
+)
+{
+	const uint8_t rows = bottom - top + 1;
+	uint8_t n = count < rows ? count : rows;
+
+	for (uint8_t y = bottom ; y >= top + n ; y--)
+		vt100_move_row(y, y - n);
+
+	for (uint8_t y = top ; y < top + n ; y++)
+		vt100_erase(y, 0, num_cols);
+}
+
+
+static void
+vt100_linefeed(void)
+{
+	wrap_pending = 0;
+
+	if (cur_row == scroll_bottom)
+		vt100_scroll_up(scroll_top, scroll_bottom, 1);
+	else
+	if (cur_row < num_rows - 1)
+		cur_row++;
+}
+
+
+static void
+vt100_reverse_linefeed(void)
+{
+	wrap_pending = 0;
+
+	if (cur_row == scroll_top)
+		vt100_scroll_down(scroll_top, scroll_bottom, 1);
+	else
+	if (cur_row > 0)
+		cur_row--;
+}
+
+
+static void
+vt100_print(
+	char c
+)
+{
+#ifdef CONFIG_FONT_8BIT
+	if (graphics && GRAPHICS_FIRST <= (uint8_t) c)
+		c += GRAPHICS_FONT - GRAPHICS_FIRST;
+#endif
+
+	// The cursor stays in the last column after it is written,
+	// and the line only wraps if another character follows.
+	if (wrap_pending)
+	{
+		cur_col = 0;
+		vt100_linefeed();
+	}
+
+	vt100_set(
+		cur_row,
+		cur_col,
+		c,
+		font_mod
+	);
+
+	if (cur_col == num_cols - 1)
+		wrap_pending = 1;
+	else
+		cur_col++;
+}
+
+
+static void
+vt100_execute(
+	char c
+)
+{
+	if (c == '\r')
+	{
+		cur_col = 0;
+		wrap_pending = 0;
 	} else
-	if (vt100_state == 2)
+	if (c == '\n' || c == '\v' || c == '\f')
 	{
-		if (c == ';')
-		{
-			vt100_state = 3;
-			return;
-		} else
-		if (c == '?')
-		{
-			vt100_query = 1;
-			return;
-		} else
-		if ('0' <= c && c <= '9')
-		{
-			arg1 = (arg1 * 10) + c - '0';
-			return;
-		} else
-		if (c == 'H')
-		{
-			// <ESC>[H == home cursor
-			cur_row = cur_col = 0;
-		} else
-		if (c == 'm')
-		{
-			// <ESC>[{arg}m == set attributes
-			// 0 == clear
-			if (arg1 == 0)
-				font_mod = FONT_NORMAL;
-		} else
-		if (c == 'A')
-		{
-			// <ESC>[{arg}A == move N lines up
-			if (cur_row < arg1)
-				cur_row = 0;
-			else
-				cur_row -= arg1;
-		} else
-		if (c == 'B')
-		{
-			// <ESC>[{arg}B == move N lines down
-			if (cur_row + arg1 >= MAX_ROWS)
-				cur_row = MAX_ROWS-1;
-			else
-				cur_row += arg1;
-		} else
-		if (c == 'D')
+		// Treated as CR LF, since that is what the hosts expect
+		cur_col = 0;
+		vt100_linefeed();
+	} else
+	if (c == '\x7')
+	{
+		// Bell!
+		buzzer();
+	} else
+	if (c == '\xF' || c == '\xE')
+	{
+		// SHIFT-IN (SI) selects G0, SHIFT-OUT (SO) selects G1
+#ifdef CONFIG_FONT_8BIT
+		charset_shift = c == '\xE';
+		graphics = charset_graphics[charset_shift];
+#endif
+	} else
+	if (c == '\x8')
+	{
+		// backup without erasing
+		wrap_pending = 0;
+		if (cur_col > 0)
+			cur_col--;
+	} else
+	if (c == '\t')
+	{
+		// tab stops every eight columns
+		wrap_pending = 0;
+		cur_col = (cur_col | 7) + 1;
+		if (cur_col >= num_cols)
+			cur_col = num_cols - 1;
+	}
+}
+
+
+/** Parameter n, or def if it is missing or zero */
+static uint16_t
+param(
+	uint8_t n,
+	uint16_t def
+)
+{
+	if (n >= num_params || params[n] == 0)
+		return def;
+	return params[n];
+}
+
+
+static void
+vt100_sgr(void)
+{
+	// <ESC>[{arg};...m == set attributes
+	// An empty list is the same as 0
+	if (num_params == 0)
+		font_mod = FONT_NORMAL;
+
+	for (uint8_t i = 0 ; i < num_params ; i++)
+	{
+		switch (params[i])
 		{
-			// <ESC>[{arg}D == move N lines to the left
-			if (cur_col < arg1)
-				cur_col = 0;
-			else
-				cur_col -= arg1;
-		} else
-		if (c == 'C')
+		case 0: font_mod = FONT_NORMAL; break;
+		case 1: font_mod |= FONT_BOLD; break;
+		case 4: font_mod |= FONT_UNDERLINE; break;
+		case 7: font_mod |= FONT_INVERSE; break;
+		case 22: font_mod &= ~FONT_BOLD; break;
+		case 24: font_mod &= ~FONT_UNDERLINE; break;
+		case 27: font_mod &= ~FONT_INVERSE; break;
+		default: break; // colors, blink, etc
+		}
+	}
+}
+
+
+/** DEC private modes, <ESC>[?{arg}h and <ESC>[?{arg}l */
+static void
+vt100_private_mode(
+	uint8_t set
+)
+{
+	for (uint8_t i = 0 ; i < num_params ; i++)
+	{
+		const uint16_t mode = params[i];
+
+		if (mode == 1048 || mode == 1049)
 		{
-			// <ESC>[{arg}C == move N lines to the right
-			if (cur_col + arg1 >= MAX_COLS)
-				cur_col = MAX_COLS-1;
-			else
-				cur_col += arg1;
-		} else
-		if (c == 'J')
+			// There is no room for an alternate screen, so
+			// 1049 is handled like 1048: the cursor is saved
+			// and restored, and the screen is left alone.  The
+			// full screen program's output stays on the screen
+			// when it exits.  47 and 1047 are ignored.
+			if (set)
+			{
+				saved_row = cur_row;
+				saved_col = cur_col;
+				saved_mod = font_mod;
+			} else {
+				cur_row = saved_row;
+				cur_col = saved_col;
+				font_mod = saved_mod;
+				wrap_pending = 0;
+			}
+		}
+
+		// Everything else (cursor visibility, application
+		// keypad, etc) has no effect on this display.
+	}
+}
+
+
+/** Append the decimal digits of n to buf */
+static uint8_t
+vt100_number(
+	char * buf,
+	uint8_t n
+)
+{
+	uint8_t len = 0;
+	if (n >= 100)
+		buf[len++] = '0' + n / 100;
+	if (n >= 10)
+		buf[len++] = '0' + n / 10 % 10;
+	buf[len++] = '0' + n % 10;
+	return len;
+}
+
+
+/** Window operations, <ESC>[{op};...t in the style of xterm */
+static void
+vt100_window(void)
+{
+	switch (param(0, 0))
+	{
+	case 8:
+	{
+		// <ESC>[8;{rows};{cols}t == resize, which picks the
+		// largest font that has at least that many cells.
+		// Missing sizes are left as they are.
+		const uint16_t rows = param(1, num_rows);
+		const uint16_t cols = param(2, num_cols);
+		uint8_t font = FONT_6X8;
+		if (rows > LCD_HEIGHT / 8 || cols > LCD_WIDTH / 6)
+			font = FONT_4X6;
+
+		vt100_font(font);
+		break;
+	}
+	case 18:
+	{
+		// <ESC>[18t == report the size as <ESC>[8;{rows};{cols}t
+		char buf[12] = "\e[8;";
+		uint8_t len = 4;
+		len += vt100_number(&buf[len], num_rows);
+		buf[len++] = ';';
+		len += vt100_number(&buf[len], num_cols);
+		buf[len++] = 't';
+		vt100_reply(buf, len);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+
+static void
+vt100_csi_dispatch(
+	char c
+)
+{
+	if (private_marker == '?')
+	{
+		if (c == 'h')
+			vt100_private_mode(1);
+		else
+		if (c == 'l')
+			vt100_private_mode(0);
+		return;
+	}
+
+	// No other private or intermediate forms are supported
+	if (private_marker || num_intermediates)
+		return;
+
+	const uint16_t n = param(0, 1);
+
+	switch (c)
+	{
+	case 'H':
+	case 'f':
+		// <ESC>[{row};{col}H == goto position row,col
+		// vt100 is 1 indexed, we are 0 indexed.
+		vt100_goto(param(0, 1), param(1, 1));
+		break;
+	case 'A':
+		// <ESC>[{arg}A == move N lines up
+		cur_row = cur_row < n ? 0 : cur_row - n;
+		wrap_pending = 0;
+		break;
+	case 'B':
+		// <ESC>[{arg}B == move N lines down
+		cur_row = cur_row + n >= num_rows ? num_rows - 1 : cur_row + n;
+		wrap_pending = 0;
+		break;
+	case 'C':
+		// <ESC>[{arg}C == move N columns to the right
+		cur_col = cur_col + n >= num_cols ? num_cols - 1 : cur_col + n;
+		wrap_pending = 0;
+		break;
+	case 'D':
+		// <ESC>[{arg}D == move N columns to the left
+		cur_col = cur_col < n ? 0 : cur_col - n;
+		wrap_pending = 0;
+		break;
+	case 'E':
+		// <ESC>[{arg}E == start of the line N down
+		vt100_goto(cur_row + 1 + n, 1);
+		break;
+	case 'F':
+		// <ESC>[{arg}F == start of the line N up
+		vt100_goto(cur_row < n ? 1 : cur_row + 1 - n, 1);
+		break;
+	case 'G':
+	case '`':
+		// <ESC>[{col}G == move to column
+		vt100_goto(cur_row + 1, n);
+		break;
+	case 'd':
+		// <ESC>[{row}d == move to row
+		vt100_goto(n, cur_col + 1);
+		break;
+	case 'J':
+		// <ESC>[{arg}J == clear the screen
+		// 0 == to the bottom
+		// 1 == to the top
+		// 2 == entire screen
+		switch (param(0, 0))
 		{
-			// <ESC>[{arg}J == clear the screen
-			// 0 == to the bottom
-			// 1 == to the top
-			// 2 == entire screen, and move home
-			// we just do a full clear
+		case 0:
+			vt100_erase(cur_row, cur_col, num_cols);
+			for (uint8_t y = cur_row + 1 ; y < num_rows ; y++)
+				vt100_erase(y, 0, num_cols);
+			break;
+		case 1:
+			for (uint8_t y = 0 ; y < cur_row ; y++)
+				vt100_erase(y, 0, num_cols);
+			vt100_erase(cur_row, 0, cur_col + 1);
+			break;
+		case 2:
+		case 3:
 			vt100_clear();
-			cur_row = cur_col = 0;
-		} else
-		if (c == 'K')
+			break;
+		}
+		break;
+	case 'K':
+		// <ESC>[{arg}K == erase in line
+		// 0 == to the end, 1 == to the start, 2 == entire line
+		switch (param(0, 0))
 		{
-			// <ESC>[K == erase to end of line
-			for (uint8_t x = cur_col ; x < MAX_COLS ; x++)
-				font_draw(x, cur_row, ' ', FONT_NORMAL);
+		case 0: vt100_erase(cur_row, cur_col, num_cols); break;
+		case 1: vt100_erase(cur_row, 0, cur_col + 1); break;
+		case 2: vt100_erase(cur_row, 0, num_cols); break;
 		}
-	} else
-	if (vt100_state == 3)
+		break;
+	case 'X':
+		// <ESC>[{arg}X == erase N characters
+		vt100_erase(cur_row, cur_col,
+			cur_col + n > num_cols ? num_cols : cur_col + n);
+		break;
+	case '@':
+	{
+		// <ESC>[{arg}@ == insert N blank characters
+		const uint8_t w = n < num_cols - cur_col ? n : num_cols - cur_col;
+
+		vt100_move_cells(cur_row, cur_col + w, cur_col, num_cols - cur_col - w);
+		vt100_erase(cur_row, cur_col, cur_col + w);
+		wrap_pending = 0;
+		break;
+	}
+	case 'P':
 	{
-		if ('0' <= c && c <= '9')
+		// <ESC>[{arg}P == delete N characters
+		const uint8_t w = n < num_cols - cur_col ? n : num_cols - cur_col;
+
+		vt100_move_cells(cur_row, cur_col, cur_col + w, num_cols - cur_col - w);
+		vt100_erase(cur_row, num_cols - w, num_cols);
+		wrap_pending = 0;
+		break;
+	}
+	case 'L':
+		// <ESC>[{arg}L == insert N lines, only inside the region
+		if (scroll_top <= cur_row && cur_row <= scroll_bottom)
 		{
-			arg2 = (arg2 * 10) + c - '0';
-			return;
-		} else
-		if (c == 'H')
+			vt100_scroll_down(cur_row, scroll_bottom, n);
+			cur_col = 0;
+			wrap_pending = 0;
+		}
+		break;
+	case 'M':
+		// <ESC>[{arg}M == delete N lines, only inside the region
+		if (scroll_top <= cur_row && cur_row <= scroll_bottom)
 		{
-			// <ESC>[{row};{col}H == goto position row,col
-			// vt100 is 1 indexed, we are 0 indexed.
-			vt100_goto(arg1, arg2);
-		} else
-		if (c == 'm')
+			vt100_scroll_up(cur_row, scroll_bottom, n);
+			cur_col = 0;
+			wrap_pending = 0;
+		}
+		break;
+	case 'S':
+		// <ESC>[{arg}S == scroll the region up N lines
+		vt100_scroll_up(scroll_top, scroll_bottom, n);
+		break;
+	case 'T':
+		// <ESC>[{arg}T == scroll the region down N lines
+		vt100_scroll_down(scroll_top, scroll_bottom, n);
+		break;
+	case 'r':
+	{
+		// <ESC>[{top};{bottom}r == set the scroll region and
+		// home the cursor.  Invalid regions are ignored.
+		const uint16_t top = param(0, 1);
+		const uint16_t bottom = param(1, num_rows);
+		if (top >= bottom || bottom > num_rows)
+			break;
+
+		scroll_top = top - 1;
+		scroll_bottom = bottom - 1;
+		vt100_goto(1, 1);
+		break;
+	}
+	case 'm':
+		vt100_sgr();
+		break;
+	case 't':
+		vt100_window();
+		break;
+	case 'n':
+		// <ESC>[6n == report the cursor as <ESC>[{row};{col}R
+		if (param(0, 0) == 6)
 		{
-			// <ESC>[{arg};{arg}m == set attributes
-			// 0 == clear
-			// no others are supported
-			if (arg1 == 0)
-				font_mod = FONT_NORMAL;
-
-			if (arg2 == 1)
-				font_mod |= FONT_UNDERLINE;
-			else
-			if (arg2 == 7)
-				font_mod |= FONT_INVERSE;
+			char buf[10] = "\e[";
+			uint8_t len = 2;
+			len += vt100_number(&buf[len], cur_row + 1);
+			buf[len++] = ';';
+			len += vt100_number(&buf[len], cur_col + 1);
+			buf[len++] = 'R';
+			vt100_reply(buf, len);
 		}
-	} else
-	if (vt100_state == 10)
+		break;
+	case 's':
+		saved_row = cur_row;
+		saved_col = cur_col;
+		saved_mod = font_mod;
+		break;
+	case 'u':
+		cur_row = saved_row;
+		cur_col = saved_col;
+		font_mod = saved_mod;
+		wrap_pending = 0;
+		break;
+	case ']':
+		// Private settings, in the style of the Linux console
+		// <ESC>[20;{ms}] == keyboard repeat delay
+		// <ESC>[21;{n}] == keyboard repeats per second, 0 == off
+		if (param(0, 0) == 20)
+			keyboard_repeat_delay(param(1, 0));
+		else
+		if (param(0, 0) == 21)
+			keyboard_repeat_rate(param(1, 0));
+		break;
+	default:
+		break;
+	}
+}
+
+
+static void
+vt100_esc_dispatch(
+	char c
+)
+{
+	if (num_intermediates)
 	{
-		// We really don't care.
+		// <ESC>({x} and <ESC>){x} select character sets for G0
+		// and G1, and <ESC>#{x} selects line sizes, which are
+		// ignored.  Anything other than special graphics is
+		// shown as ASCII.
+#ifdef CONFIG_FONT_8BIT
+		const uint8_t g = intermediates[0] - '(';
+		if (num_intermediates == 1 && g < 2)
+		{
+			charset_graphics[g] = c == '0';
+			graphics = charset_graphics[charset_shift];
+		}
+#endif
+		return;
 	}
 
-	// If we have fallen through to here, we are done and should
-	// exit vt100 mode.
-	vt100_state = 0;
-	return;
+	switch (c)
+	{
+	case 'c':
+		// reset everything
+		vt100_clear();
+		cur_row = cur_col = 0;
+		wrap_pending = 0;
+		font_mod = FONT_NORMAL;
+		scroll_top = 0;
+		scroll_bottom = num_rows - 1;
+#ifdef CONFIG_FONT_8BIT
+		charset_graphics[0] = charset_graphics[1] = 0;
+		charset_shift = graphics = 0;
+#endif
+		break;
+	case '7':
+		saved_row = cur_row;
+		saved_col = cur_col;
+		saved_mod = font_mod;
+		break;
+	case '8':
+		cur_row = saved_row;
+		cur_col = saved_col;
+		font_mod = saved_mod;
+		wrap_pending = 0;
+		break;
+	case 'D':
+		// index, down one line
+		vt100_linefeed();
+		break;
+	case 'E':
+		// next line
+		cur_col = 0;
+		vt100_linefeed();
+		break;
+	case 'M':
+		// reverse index, up one line
+		vt100_reverse_linefeed();
+		break;
+	default:
+		break;
+	}
+}
+
+
+static void
+vt100_action(
+	uint8_t action,
+	char c
+)
+{
+	switch (action)
+	{
+	case ACTION_PRINT:
+		vt100_print(c);
+		break;
+	case ACTION_EXECUTE:
+		vt100_execute(c);
+		break;
+	case ACTION_CLEAR:
+		num_params = 0;
+		num_intermediates = 0;
+		private_marker = 0;
+		break;
+	case ACTION_COLLECT:
+		if ('<' <= c && c <= '?')
+			private_marker = c;
+		else
+		if (num_intermediates < VT100_MAX_INTERMEDIATES)
+			intermediates[num_intermediates++] = c;
+		break;
+	case ACTION_PARAM:
+		if (num_params == 0)
+			params[num_params++] = 0;
+		if (c == ';')
+		{
+			if (num_params < VT100_MAX_PARAMS)
+				params[num_params++] = 0;
+		} else {
+			// Saturate instead of wrapping the 16 bits
+			uint16_t * const p = &params[num_params - 1];
+			const uint8_t digit = c - '0';
+			if (*p > (VT100_MAX_PARAM - digit) / 10)
+				*p = VT100_MAX_PARAM;
+			else
+				*p = *p * 10 + digit;
+		}
+		break;
+	case ACTION_ESC_DISPATCH:
+		vt100_esc_dispatch(c);
+		break;
+	case ACTION_CSI_DISPATCH:
+		vt100_csi_dispatch(c);
+		break;
+	default:
+		break;
+	}
 }
 
 
@@ -213,88 +1140,136 @@ vt100_putc(
 	char c
 )
 {
-	if (c == '\e')
+	const uint8_t b = c;
+
+	// Printable characters on the ground state are the common
+	// case, so skip the table search for them.
+	if (vt100_state == STATE_GROUND && 0x20 <= b && b < 0x7F)
 	{
-		vt100_state = 1;
+		vt100_print(c);
 		return;
-	} else
-	if (vt100_state)
+	}
+
+	// Transitions from anywhere
+	if (b == 0x18 || b == 0x1A)
 	{
-		vt100_process(c);
+		// CAN and SUB abort any sequence
+		vt100_state = STATE_GROUND;
 		return;
 	}
 
-	if (c == '\r')
-	{
-		cur_col = 0;
-	} else
-	if (c == '\n')
-	{
-		goto new_row;
-	} else
-	if (c == '\x7')
+	if (b == 0x1B)
 	{
-		// Bell!
-		buzzer();
-	} else
-	if (c == '\xF')
-	{
-		// ^O or ASCII SHIFT-IN (SI) switches sets?
-	} else
- 	if (c == '\xE')
+		vt100_state = STATE_ESCAPE;
+		vt100_action(ACTION_CLEAR, c);
+		return;
+	}
+
+	const vt100_transition_t * t = &vt100_transitions[
+		pgm_read_byte(&vt100_state_start[vt100_state])
+	];
+
+	while (1)
 	{
-		// ^P or ASCII SHIFT-OUT (SO) switches sets, too
-		// We do not support alternate char sets for now.
-		// ignore.
-	} else
-	if (c == '\x8')
+		const uint8_t lo = pgm_read_byte(&t->lo);
+		const uint8_t hi = pgm_read_byte(&t->hi);
+		if (lo <= b && b <= hi)
+			break;
+		t++;
+	}
+
+	vt100_action(pgm_read_byte(&t->action), c);
+	vt100_state = pgm_read_byte(&t->next);
+}
+
+
+/** Draw a run of printable characters that fits on the current line.
+ *
+ * Only the span between the first and last cells that change is
+ * rendered, as a single write to the LCD.
+ */
+static void
+vt100_print_run(
+	const char * const buf,
+	const uint8_t n
+)
+{
+	vt100_cell_t * const row = &cells[cur_row][cur_col];
+	uint8_t first = n;
+	uint8_t last = 0;
+
+	for (uint8_t i = 0 ; i < n ; i++)
 	{
-		// erase the old char and backup
-		font_draw(cur_col, cur_row, ' ', FONT_NORMAL);
-		if (cur_col > 0)
-		{
-			cur_col--;
-		} else {
-			cur_col = 40;
-			cur_row = (cur_row - 1 + MAX_ROWS) % MAX_ROWS;
-		}
-	} else {
-		font_draw(
-			cur_col,
+		vt100_cell_t * const cell = &row[i];
+		if (cell->c == (uint8_t) buf[i] && cell->mod == font_mod)
+			continue;
+
+		cell->c = buf[i];
+		cell->mod = font_mod;
+		if (i < first)
+			first = i;
+		last = i + 1;
+	}
+
+	if (first < last)
+		font_draw_run(
+			cur_col + first,
 			cur_row,
-			c,
+			&buf[first],
+			last - first,
 			font_mod
 		);
 
-		if (++cur_col == 40)
-			goto new_row;
+	// The cursor stays in the last column, as in vt100_print()
+	cur_col += n;
+	if (cur_col == num_cols)
+	{
+		cur_col = num_cols - 1;
+		wrap_pending = 1;
 	}
+}
 
-	return;
 
-new_row:
-	if (cur_row < MAX_ROWS-1)
+void
+vt100_write(
+	const char * buf,
+	uint8_t n
+)
+{
+	while (n)
 	{
-		cur_row++;
-		cur_col = 0;
-		return;
-	}
+		const uint8_t b = *buf;
 
-	// We are scrolling.  Omg.  How do we do this.
-	cur_col = 0;
-#define BLIT_WIDTH 50
-	static uint8_t bits[BLIT_WIDTH];
+		// Characters in the graphics set are translated one at
+		// a time by vt100_print().
+		if (vt100_state != STATE_GROUND || b < 0x20 || b >= 0x7F || graphics)
+		{
+			vt100_putc(b);
+			buf++;
+			n--;
+			continue;
+		}
 
-	for (int x = 0 ; x < 240 ; x += BLIT_WIDTH)
-	{
-		for (int y = 0 ; y < 64-8 ; y += 8)
+		if (wrap_pending)
 		{
-			lcd_read(x, y+8, bits, BLIT_WIDTH);
-			lcd_write(x, y, bits, BLIT_WIDTH);
+			cur_col = 0;
+			vt100_linefeed();
+		}
+
+		// Find the run of printable characters on this line
+		const uint8_t room = num_cols - cur_col;
+		uint8_t len = 1;
+
+		while (len < n && len < room)
+		{
+			const uint8_t next = buf[len];
+			if (next < 0x20 || next >= 0x7F)
+				break;
+			len++;
 		}
-	}
 
-	// Clear the last row
-	for (uint8_t x = 0 ; x < MAX_COLS ; x++)
-		font_draw(x, cur_row, ' ', FONT_NORMAL);
+		vt100_print_run(buf, len);
+		buf += len;
+		n -= len;
+	}
 }
@@ -8,14 +8,59 @@
 #include <stdint.h>
 
 
+/** Reset the screen contents and blank the display. */
+extern void
+vt100_init(void);
+
+
 extern void
 vt100_clear(void);
 
 
+/** Switch to another font and redraw the screen in its cells.
+ *
+ * The screen size follows the font; text that no longer fits is
+ * lost, and the scroll region is reset.
+ */
+extern void
+vt100_font(
+	uint8_t font
+);
+
+
+/** Redraw every character cell, resending the entire display. */
+extern void
+vt100_redraw(void);
+
+
+/** Draw one row from its cells, over anything that was drawn on the
+ * LCD directly.  Only the columns that differ are sent.
+ */
+extern void
+vt100_redraw_row(
+	uint8_t row
+);
+
+
+/** Read back one character cell, for checking the screen model.
+ *
+ * \return the character in the low byte and its font attributes in
+ * the high byte, or 0 outside the screen.
+ */
+extern uint16_t
+vt100_cell(
+	uint8_t row,
+	uint8_t col
+);
+
+
+/** Move the cursor to a 1 indexed row and column, clamped to the
+ * screen.  0 is the same as 1.
+ */
 extern void
 vt100_goto(
-	uint8_t new_row,
-	uint8_t new_col
+	uint16_t new_row,
+	uint16_t new_col
 );
 
 
@@ -25,4 +70,28 @@ vt100_putc(
 );
 
 
+/** Process a buffer of input.
+ *
+ * Runs of printable characters are drawn together, and everything
+ * else goes through vt100_putc().
+ */
+extern void
+vt100_write(
+	const char * buf,
+	uint8_t n
+);
+
+
+/** Send a reply to the host, such as a size report.
+ *
+ * This is not part of the terminal; whoever links it in has to
+ * provide it.
+ */
+extern void
+vt100_reply(
+	const char * buf,
+	uint8_t n
+);
+
+
 #endif
@@ -0,0 +1,94 @@
+/**
+ * Testbench for the fifo between clock domains.
+ *
+ * Writes a counting sequence on one clock and reads it back on an
+ * unrelated one, first with the writer faster so that the fifo fills
+ * up and then with the reader faster so that it runs dry.  Every
+ * value must come out once and in order, with none lost while full.
+ *
+ * Run with "make test".
+ */
+`timescale 1ns / 1ps
+`include "util.v"
+
+module async_fifo_tb;
+	localparam COUNT = 2000;
+
+	reg write_clk = 0;
+	reg read_clk = 0;
+	reg reset = 1;
+	realtime write_half = 5.3;
+	realtime read_half = 21.7;
+	always #(write_half) write_clk = ~write_clk;
+	always #(read_half) read_clk = ~read_clk;
+
+	wire full;
+	wire data_available;
+	wire [15:0] read_data;
+	reg [15:0] write_count = 0;
+	reg [15:0] read_count = 0;
+	integer errors = 0;
+
+	wire write_strobe = !reset && !full && write_count != COUNT;
+	wire read_strobe = !reset && data_available;
+
+	async_fifo #(.WIDTH(16), .NUM(16)) dut(
+		.reset(reset),
+		.write_clk(write_clk),
+		.write_data(write_count),
+		.write_strobe(write_strobe),
+		.full(full),
+		.read_clk(read_clk),
+		.data_available(data_available),
+		.read_data(read_data),
+		.read_strobe(read_strobe)
+	);
+
+	always @(posedge write_clk)
+		if (write_strobe)
+			write_count <= write_count + 1;
+
+	always @(posedge read_clk) begin
+		if (read_strobe) begin
+			if (read_data !== read_count) begin
+				$display("read %0d, expected %0d",
+					read_data, read_count);
+				errors = errors + 1;
+			end
+			read_count <= read_count + 1;
+		end
+	end
+
+	initial begin
+		repeat(4) @(posedge read_clk);
+		reset <= 0;
+
+		// the writer gets ahead and has to wait while full
+		wait(read_count == COUNT / 2);
+
+		// then the reader waits for every value
+		write_half = 37.1;
+		read_half = 3.9;
+		wait(read_count == COUNT);
+		repeat(16) @(posedge read_clk);
+
+		if (data_available) begin
+			$display("data left over");
+			errors = errors + 1;
+		end
+
+		if (errors != 0) begin
+			$display("FAIL: %0d errors", errors);
+			$finish_and_return(1);
+		end
+
+		$display("PASS");
+		$finish;
+	end
+
+	initial begin
+		#1000000;
+		$display("FAIL: timeout, read %0d", read_count);
+		$finish_and_return(1);
+	end
+endmodule
@@ -0,0 +1,54 @@
+`ifndef _framebuffer_v_
+`define _framebuffer_v_
+
+/**
+ * Bitmap framebuffer, written in the plain synchronous RAM style
+ * that the tools can map to block RAM.
+ *
+ * The 240x64 display is stored as bytes in the LCD's own layout,
+ * one byte for each column of each 8 pixel page with the top pixel
+ * in the LSB, at address { page, x }.  The x addresses from 240 to
+ * 255 are unused so that the address is just the two coordinates,
+ * 2048 bytes in all.
+ *
+ * The read port is registered, so the pixels are one clock behind
+ * read_x and read_y, which the LCD driver's pipeline allows for.
+ * The write port writes the bits of one byte that are set in
+ * write_mask, so single pixels can be written without reading the
+ * byte first.  Both ports are on the same clock; writers in other
+ * clock domains go through an async_fifo.
+ */
+
+module framebuffer(
+	input clk,
+
+	// read out
+	input [7:0] read_x, // 0 - 239 pixels
+	input [2:0] read_y, // 0 - 7 pages
+	output reg [7:0] read_data,
+
+	// write update
+	input write_strobe,
+	input [7:0] write_x, // 0 - 239 pixels
+	input [2:0] write_y, // 0 - 7 pages
+	input [7:0] write_data,
+	input [7:0] write_mask
+);
+	reg [7:0] ram[0:2047];
+	initial $readmemh("fb.hex", ram);
+
+	integer i;
+
+	always @(posedge clk)
+	begin
+		read_data <= ram[{ read_y, read_x }];
+
+		if (write_strobe) begin
+			for(i = 0 ; i < 8 ; i = i + 1)
+				if (write_mask[i])
+					ram[{ write_y, write_x }][i] <= write_data[i];
+		end
+	end
+endmodule
+
+`endif
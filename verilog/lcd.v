@@ -6,11 +6,31 @@
  *
  * Enable pin clocks data at the falling edge.
  *
- * This draws a row at a time in auto-advance mode.
- *
  * Each chip handles a 50x32 rectangle and is updated 8 pixel columns
  * at a time.  The column address auto-advances, so the address only
- * needs to be set at the start of each column.
+ * needs to be set at the start of each page.
+ *
+ * Only the regions that have changed are redrawn.  A region is one
+ * page of one chip, 50x8 pixels, and there are 40 of them, numbered
+ * page * 10 + chip.  The writers set bits in the dirty mask, see
+ * lcd_region below; the scanner skips clean regions a clock each, and
+ * for a dirty one sends that chip its page address and the 50 bytes.
+ * The region's clean bit is pulsed when it starts, so a write that
+ * lands while it is being drawn marks it again.
+ *
+ * The bus timing is given in nanoseconds and converted to clocks, so
+ * the panel runs as fast as the HD44102 allows instead of from a
+ * fixed clock divider.  The defaults are the datasheet limits.  Every
+ * write is one enable cycle:
+ *
+ *	hold	enable low after the falling edge, bus unchanged
+ *	setup	enable low, the next chip select and data on the bus
+ *	high	enable high, latched at the end
+ *
+ * The data path is pipelined: x and y already point at the next byte
+ * while the current one is on the bus, so the pixels have a whole
+ * cycle to arrive.  PIXEL_DELAY is how many clocks the pixel source
+ * takes from x and y to its output.
  */
 
 module lcd(
@@ -21,18 +41,50 @@ module lcd(
 	input [7:0] pixels,
 	output reg [7:0] x, // 240 columns
 	output reg [2:0] y, // 8 rows of 8 pixels
-	input frame_strobe, // start a new frame
+	input frame_strobe, // allowed to draw
+	input [REGIONS-1:0] dirty,
+	output reg [REGIONS-1:0] clean,
 
 	// pins
 	output reg [7:0] data_pin,
 	output reg [LCD_MODULES-1:0] cs_pin,
 	output reg cs1_pin,
-	output reg rw_pin,
+	output rw_pin,
 	output reg di_pin,
 	output reg enable_pin,
 	output reg reset_pin
 );
 	parameter LCD_MODULES = 10;
+	parameter REGIONS = LCD_MODULES * 4;
+	parameter CLK_MHZ = 48;
+	parameter PIXEL_DELAY = 2; // clocks
+
+	parameter T_CYCLE = 1000; // ns, falling edge to falling edge
+	parameter T_ENABLE_HIGH = 450; // ns
+	parameter T_ENABLE_LOW = 450; // ns
+	parameter T_SETUP = 200; // ns, chip select and data before the edges
+	parameter T_HOLD = 10; // ns, after the falling edge
+	parameter T_RESET_US = 700000; // us, reset held at power up
+
+	// nanoseconds rounded up to clocks
+	localparam CLK_CYCLE = (T_CYCLE * CLK_MHZ + 999) / 1000;
+	localparam CLK_ENABLE_HIGH = (T_ENABLE_HIGH * CLK_MHZ + 999) / 1000;
+	localparam CLK_ENABLE_LOW = (T_ENABLE_LOW * CLK_MHZ + 999) / 1000;
+	localparam CLK_SETUP_NS = (T_SETUP * CLK_MHZ + 999) / 1000;
+	localparam CLK_HOLD_NS = (T_HOLD * CLK_MHZ + 999) / 1000;
+
+	// length of each phase, at least one clock each
+	localparam CLK_HOLD = CLK_HOLD_NS < 1 ? 1 : CLK_HOLD_NS;
+	localparam CLK_HIGH = CLK_ENABLE_HIGH < 1 ? 1 : CLK_ENABLE_HIGH;
+	localparam CLK_SETUP_1 = CLK_SETUP_NS > PIXEL_DELAY
+		? CLK_SETUP_NS : PIXEL_DELAY;
+	localparam CLK_SETUP_2 = CLK_ENABLE_LOW - CLK_HOLD > CLK_SETUP_1
+		? CLK_ENABLE_LOW - CLK_HOLD : CLK_SETUP_1;
+	localparam CLK_SETUP_3 = CLK_CYCLE - CLK_HOLD - CLK_HIGH > CLK_SETUP_2
+		? CLK_CYCLE - CLK_HOLD - CLK_HIGH : CLK_SETUP_2;
+	localparam CLK_SETUP = CLK_SETUP_3 < 1 ? 1 : CLK_SETUP_3;
+
+	localparam RESET_CLOCKS = T_RESET_US * CLK_MHZ;
 
 	assign rw_pin = 0; // always write
 
@@ -42,28 +94,54 @@ module lcd(
 	localparam STATE_UP	= 3;
 	localparam STATE_PAGE	= 4;
 	localparam STATE_WAIT	= 5;
-	localparam STATE_WAIT1	= 6;
-	localparam STATE_WAIT2	= 7;
-	localparam STATE_WAIT3	= 8;
+	localparam STATE_WAIT4	= 6;
+	localparam STATE_RISE	= 7;
+	localparam STATE_FALL	= 8;
 	localparam STATE_DONE	= 9;
-	localparam STATE_COORD	= 10;
-	localparam STATE_COORD2 = 11;
-	localparam STATE_WAIT4	= 12;
-	localparam STATE_DATA	= 13;
-	localparam STATE_DATA2  = 14;
-	localparam STATE_DATA3  = 15;
-
-	localparam MAX_X	= 240;
+	localparam STATE_SCAN	= 10;
+	localparam STATE_DATA	= 11;
+
 	localparam X_PER_MODULE	= 50;
 
-	reg [24:0] counter;
+	reg [31:0] counter;
+	reg [7:0] timer;
 	reg [3:0] state;
-	reg [3:0] next_state;
-	reg [6:0] disp_x;
+	reg [3:0] next_state; // after a command
+	reg [3:0] strobe_state; // after an enable cycle
+
+	// the region being looked at by the scanner
+	reg [5:0] region;
+	reg [LCD_MODULES-1:0] region_cs;
+	reg [1:0] region_page;
+	reg [7:0] region_x;
+	reg [5:0] column;
+
+	// start an enable cycle with the bus as it is now
+	task strobe;
+		input [3:0] after;
+	begin
+		timer <= CLK_SETUP - 1;
+		state <= STATE_RISE;
+		strobe_state <= after;
+	end
+	endtask
+
+	// move the scanner on to the next chip, and the next page after
+	// the last one
+	task next_region;
+	begin
+		region <= region == REGIONS-1 ? 0 : region + 1;
+		region_cs <= { region_cs[9-1:0], region_cs[9] };
+		region_x <= region_cs[4] || region_cs[9] ? 0
+			: region_x + X_PER_MODULE;
+		if (region_cs[9])
+			region_page <= region_page + 1;
+	end
+	endtask
 
 	always @(posedge clk)
 	begin
-		counter <= counter + 1;
+		clean <= 0;
 
 		if (reset) begin
 			state <= STATE_INIT;
@@ -72,29 +150,29 @@ module lcd(
 			cs1_pin <= 0;
 			x <= 0;
 			y <= 0;
-			disp_x <= 0;
-			enable_pin <= 1;
+			region <= 0;
+			region_cs <= 1;
+			region_page <= 0;
+			region_x <= 0;
+			enable_pin <= 0;
+			timer <= 0;
 		end else
-		if (counter[4:0] != 0) begin
-			// do nothing... stretch the clocks
-			// at 48 MHz this is a divide by 32, so roughly
-			// a 1.5 MHz clock.
+		if (timer != 0) begin
+			// wait out the current phase
+			timer <= timer - 1;
 		end else
 		case(state)
 		STATE_INIT: begin
 			reset_pin <= 1;
 			state <= STATE_RESET;
-			counter <= 1;
-			enable_pin <= 1;
-			x <= 0;
-			y <= 0;
-			disp_x <= 0;
-			enable_pin <= 1;
+			counter <= 0;
+			enable_pin <= 0;
 		end
 		STATE_RESET: begin
-			// hold for a few ms
+			// hold for T_RESET_US, 700 ms by default
 			cs1_pin <= 1;
-			if (counter == 0)
+			counter <= counter + 1;
+			if (counter == RESET_CLOCKS)
 				state <= STATE_ON;
 			data_pin <= 0;
 		end
@@ -115,121 +193,79 @@ module lcd(
 			state <= STATE_WAIT;
 		end
 		STATE_DONE: begin
-			state <= STATE_COORD;
+			state <= STATE_SCAN;
 		end
 
-		/* Busy wait after a command and send to all modules */
+		/* Send the command on the bus to all modules */
 		STATE_WAIT: begin
-			enable_pin <= 1;
 			cs_pin <= 1;
-			state <= STATE_WAIT2;
-		end
-		STATE_WAIT2: begin
-			// strobe the enable pin and wait a little while
-			enable_pin <= 0;
-			state <= STATE_WAIT3;
-			//counter <= 1;
-		end
-		STATE_WAIT3: begin
-			enable_pin <= 1;
-			state <= STATE_WAIT4;
+			strobe(STATE_WAIT4);
 		end
 		STATE_WAIT4: begin
-			// select the next module
-			cs_pin <= { cs_pin[9-1:0], cs_pin[9] };
-
 			// have all have been selected?
-			if (cs_pin[9])
+			if (cs_pin[9]) begin
 				state <= next_state;
-			else
-				state <= STATE_WAIT2;
+			end else begin
+				// select the next module
+				cs_pin <= { cs_pin[9-1:0], cs_pin[9] };
+				strobe(STATE_WAIT4);
+			end
 		end
 
-		/* Framebuffer drawing code.
-		 */
-		STATE_COORD: begin
-		 	// Send all the devices to the same row/column.
-			// disp_x is ignored, since we always start at first
-			di_pin <= 0;
-			data_pin <= { y[1:0], 6'b000000 };
+		/* One enable cycle, entered after the setup time */
+		STATE_RISE: begin
 			enable_pin <= 1;
-			next_state <= STATE_COORD2;
-			state <= STATE_WAIT;
-
+			timer <= CLK_HIGH - 1;
+			state <= STATE_FALL;
+		end
+		STATE_FALL: begin
+			// the modules latch the bus on this edge
+			enable_pin <= 0;
+			timer <= CLK_HOLD - 1;
+			state <= strobe_state;
 		end
-		STATE_COORD2: begin
-			// we start on the very first module after a
-			// coordinate update.
-			cs_pin <= 1;
-			// data, not instruction
-			di_pin <= 1;
-
-			// return to the first column
-			x <= 0;
-			disp_x <= 0;
-
-			enable_pin <= 1;
 
-			if (y == 0) begin
-				if (!frame_strobe)
-					// deselect the LCD
-					// wait for the strobe
-					cs1_pin <= 0;
-				else begin
-					// start drawing
-					cs1_pin <= 1;
-					state <= STATE_DATA;
-				end
+		/* Framebuffer drawing code.
+		 */
+		STATE_SCAN: begin
+			if (!frame_strobe) begin
+				// deselect the LCD
+				// wait for the strobe
+				cs1_pin <= 0;
+			end else
+			if (!dirty[region]) begin
+				next_region();
 			end else begin
-				// resume drawing at the start of this row
-				state <= STATE_DATA;
+				// send just this chip to the start of the page,
+				// and start fetching its first byte
+				clean[region] <= 1;
+				cs1_pin <= 1;
+				cs_pin <= region_cs;
+				di_pin <= 0;
+				data_pin <= { region_page, 6'b000000 };
+				strobe(STATE_DATA);
+
+				x <= region_x;
+				y <= { region_cs[9:5] != 0, region_page };
+				column <= 0;
 			end
 		end
 
 		STATE_DATA: begin
-			enable_pin <= 1;
+			// put the fetched byte on the bus,
+			// data, not instruction
+			di_pin <= 1;
 			data_pin <= pixels;
-			state <= STATE_DATA2;
-		end
-		STATE_DATA2: begin
-			// everything is stable, clock the modules
-			enable_pin <= 0;
-			state <= STATE_DATA3;
-		end
-		STATE_DATA3: begin
-			enable_pin <= 1;
 
-			// default is to select the next module
-			// and continue to display the same column
-			state <= STATE_DATA;
-			cs_pin <= { cs_pin[9-1:0], cs_pin[9] };
-			x <= x + X_PER_MODULE;
-
-			if (cs_pin[4]) begin
-				// end of first row of modules
-				// move to the second row
-				// rewind x to be back at the current
-				// display column
-				y[2] <= 1;
-				x <= disp_x;
-			end else
-			if (cs_pin[9]) begin
-				// end of the second row of modules
-				// go back to the first row
-				y[2] <= 0;
-
-				if (disp_x == X_PER_MODULE-1) begin
-					// move back to the first module,
-					// on the next Y data page
-					state <= STATE_COORD;
-					y[1:0] <= y[1:0] + 1;
-					x <= 0;
-					disp_x <= 0;
-				end else begin
-					// advance the display X coordinate
-					disp_x <= disp_x + 1;
-					x <= disp_x + 1;
-				end
+			if (column == X_PER_MODULE-1) begin
+				// that was the whole region
+				strobe(STATE_SCAN);
+				next_region();
+			end else begin
+				// and start fetching the next one
+				strobe(STATE_DATA);
+				column <= column + 1;
+				x <= x + 1;
 			end
 		end
 		endcase
@@ -238,4 +274,24 @@ module lcd(
 endmodule
 
 
+/*
+ * The dirty region bit for the byte at x and page y, in the same
+ * coordinates as the lcd module's x and y outputs.
+ */
+module lcd_region(
+	input [7:0] x,
+	input [2:0] y,
+	output [39:0] mask
+);
+	wire [2:0] chip =
+		x < 50 ? 0 :
+		x < 100 ? 1 :
+		x < 150 ? 2 :
+		x < 200 ? 3 :
+		4;
+
+	assign mask = 40'b1 << (y[1:0] * 10 + (y[2] ? 5 : 0) + chip);
+endmodule
+
+
 `endif
@@ -0,0 +1,275 @@
+/**
+ * Timing testbench for the LCD driver.
+ *
+ * Runs the lcd module with a few sets of timing parameters and
+ * watches the pins like an HD44102 would.  Every enable cycle is
+ * checked against the parameters in nanoseconds: the pulse widths,
+ * the cycle time, the setup of the chip selects and data before the
+ * edges, and that nothing on the bus changes during the hold time.
+ *
+ * The pixels are a pattern of x and y, delayed by PIXEL_DELAY clocks
+ * like the text mode font lookup.  Every byte that is latched is
+ * compared with the pattern for the module's page and column, so a
+ * pipeline that gets ahead of the pixels is caught too.
+ *
+ * The regions in DIRTY are kept dirty, so they are redrawn over and
+ * over, and nothing else may be drawn.  Two frames of them are drawn
+ * for each set and the frame rate is printed.
+ *
+ * Run with "make test".
+ */
+`timescale 1ns / 1ps
+`include "lcd.v"
+
+module lcd_timing(
+	output reg done,
+	output reg [31:0] errors
+);
+	parameter CLK_MHZ = 48;
+	parameter PIXEL_DELAY = 2;
+	parameter T_CYCLE = 1000;
+	parameter T_ENABLE_HIGH = 450;
+	parameter T_ENABLE_LOW = 450;
+	parameter T_SETUP = 200;
+	parameter T_HOLD = 10;
+	parameter DIRTY = ~40'h0;
+	parameter DIRTY_COUNT = 40;
+
+	localparam BYTES_PER_FRAME = DIRTY_COUNT * 50;
+	localparam FRAMES = 2;
+
+	reg clk = 0;
+	reg reset = 1;
+	always #(500.0 / CLK_MHZ) clk = ~clk;
+
+	wire [7:0] x;
+	wire [2:0] y;
+	wire [7:0] data_pin;
+	wire [9:0] cs_pin;
+	wire cs1_pin;
+	wire rw_pin;
+	wire di_pin;
+	wire enable_pin;
+	wire reset_pin;
+	wire [39:0] clean;
+
+	// test pattern, different for every byte on the screen
+	function [7:0] pattern;
+		input [7:0] x;
+		input [2:0] y;
+	begin
+		pattern = x ^ { y, y, 2'b01 };
+	end
+	endfunction
+
+	// pixel source with the same latency as the text mode
+	reg [7:0] delayed[0:7];
+	wire [7:0] pixels = PIXEL_DELAY == 0
+		? pattern(x, y)
+		: delayed[PIXEL_DELAY == 0 ? 0 : PIXEL_DELAY-1];
+	integer i;
+	always @(posedge clk) begin
+		delayed[0] <= pattern(x, y);
+		for(i = 1 ; i < 8 ; i = i + 1)
+			delayed[i] <= delayed[i-1];
+	end
+
+	lcd #(
+		.CLK_MHZ(CLK_MHZ),
+		.PIXEL_DELAY(PIXEL_DELAY),
+		.T_CYCLE(T_CYCLE),
+		.T_ENABLE_HIGH(T_ENABLE_HIGH),
+		.T_ENABLE_LOW(T_ENABLE_LOW),
+		.T_SETUP(T_SETUP),
+		.T_HOLD(T_HOLD),
+		.T_RESET_US(1)
+	) dut(
+		.clk(clk),
+		.reset(reset),
+		.pixels(pixels),
+		.x(x),
+		.y(y),
+		.frame_strobe(1'b1),
+		.dirty(DIRTY),
+		.clean(clean),
+		.data_pin(data_pin),
+		.cs_pin(cs_pin),
+		.cs1_pin(cs1_pin),
+		.rw_pin(rw_pin),
+		.di_pin(di_pin),
+		.enable_pin(enable_pin),
+		.reset_pin(reset_pin)
+	);
+
+	always @(posedge clk) begin
+		if ((clean & ~DIRTY) != 0) begin
+			$display("%0d MHz: cleaned %h", CLK_MHZ, clean);
+			errors = errors + 1;
+		end
+	end
+
+	// when the pins last changed
+	realtime t_rise = 0;
+	realtime t_fall = -1000000;
+	realtime t_cs = 0;
+	realtime t_data = 0;
+
+	always @(cs_pin or di_pin)
+		t_cs = $realtime;
+	always @(data_pin)
+		t_data = $realtime;
+
+	// a change during the hold time after the falling edge
+	always @(cs_pin or di_pin or data_pin) begin
+		if (done == 0 && $realtime - t_fall < T_HOLD) begin
+			$display("%0d MHz: bus changed %0.1f ns after the fall",
+				CLK_MHZ, $realtime - t_fall);
+			errors = errors + 1;
+		end
+	end
+
+	always @(posedge enable_pin) if (!reset) begin
+		if ($realtime - t_fall < T_ENABLE_LOW) begin
+			$display("%0d MHz: enable low %0.1f ns",
+				CLK_MHZ, $realtime - t_fall);
+			errors = errors + 1;
+		end
+		if ($realtime - t_cs < T_SETUP) begin
+			$display("%0d MHz: select setup %0.1f ns",
+				CLK_MHZ, $realtime - t_cs);
+			errors = errors + 1;
+		end
+		t_rise = $realtime;
+	end
+
+	// the modules' addresses, as the HD44102 keeps them
+	reg [1:0] page[0:9];
+	reg [5:0] column[0:9];
+	integer m;
+	integer bytes = 0;
+	integer commands = 0;
+	realtime t_frame = 0;
+	realtime t_frame_len = 0;
+
+	always @(negedge enable_pin) if (!reset) begin
+		if ($realtime - t_rise < T_ENABLE_HIGH) begin
+			$display("%0d MHz: enable high %0.1f ns",
+				CLK_MHZ, $realtime - t_rise);
+			errors = errors + 1;
+		end
+		if ($realtime - t_fall < T_CYCLE) begin
+			$display("%0d MHz: cycle %0.1f ns",
+				CLK_MHZ, $realtime - t_fall);
+			errors = errors + 1;
+		end
+		if ($realtime - t_data < T_SETUP) begin
+			$display("%0d MHz: data setup %0.1f ns",
+				CLK_MHZ, $realtime - t_data);
+			errors = errors + 1;
+		end
+		t_fall = $realtime;
+
+		for(m = 0 ; m < 10 ; m = m + 1) begin
+			if (!cs1_pin || !cs_pin[m]) begin
+				// not selected
+			end else
+			if (!di_pin) begin
+				// only the address commands, not on, up
+				// or the start page
+				if (data_pin[5:0] < 50) begin
+					page[m] = data_pin[7:6];
+					column[m] = data_pin[5:0];
+				end
+				commands = commands + 1;
+			end else begin
+				if (!DIRTY[page[m] * 10 + m]) begin
+					$display("%0d MHz: module %0d page %0d is clean",
+						CLK_MHZ, m, page[m]);
+					errors = errors + 1;
+				end
+				if (data_pin !== pattern(
+					(m % 5) * 50 + column[m],
+					{ (m >= 5 ? 1'b1 : 1'b0), page[m] }
+				)) begin
+					$display("%0d MHz: module %0d page %0d column %0d: %h",
+						CLK_MHZ, m, page[m], column[m], data_pin);
+					errors = errors + 1;
+				end
+				column[m] = column[m] + 1;
+
+				if (bytes % BYTES_PER_FRAME == 0) begin
+					t_frame_len = $realtime - t_frame;
+					t_frame = $realtime;
+				end
+
+				bytes = bytes + 1;
+			end
+		end
+
+		if (bytes == FRAMES * BYTES_PER_FRAME && !done) begin
+			$display("%0d MHz: %0.0f ns per frame, %0.0f Hz",
+				CLK_MHZ, t_frame_len, 1.0e9 / t_frame_len);
+			done = 1;
+		end
+	end
+
+	initial begin
+		done = 0;
+		errors = 0;
+		repeat(4) @(posedge clk);
+		reset <= 0;
+	end
+endmodule
+
+
+module lcd_tb;
+	wire [3:0] done;
+	wire [31:0] errors[0:3];
+
+	// datasheet limits
+	lcd_timing #(.CLK_MHZ(48)) datasheet(done[0], errors[0]);
+
+	// a slower clock, where the rounding up to clocks matters
+	lcd_timing #(
+		.CLK_MHZ(12),
+		.PIXEL_DELAY(0)
+	) slow(done[1], errors[1]);
+
+	// pushed hard, with a deep pixel pipeline
+	lcd_timing #(
+		.CLK_MHZ(48),
+		.PIXEL_DELAY(6),
+		.T_CYCLE(0),
+		.T_ENABLE_HIGH(100),
+		.T_ENABLE_LOW(0),
+		.T_SETUP(0),
+		.T_HOLD(0)
+	) fast(done[2], errors[2]);
+
+	// one region on the bottom half, the latency of a small write
+	lcd_timing #(
+		.CLK_MHZ(48),
+		.DIRTY(40'h1 << 17),
+		.DIRTY_COUNT(1)
+	) region(done[3], errors[3]);
+
+	initial begin
+		wait(done == 4'b1111);
+
+		if (errors[0] + errors[1] + errors[2] + errors[3] != 0) begin
+			$display("FAIL: %0d errors",
+				errors[0] + errors[1] + errors[2] + errors[3]);
+			$finish_and_return(1);
+		end
+
+		$display("PASS");
+		$finish;
+	end
+
+	initial begin
+		// two frames at the datasheet timing take about 4 ms
+		#50000000;
+		$display("FAIL: timeout");
+		$finish_and_return(1);
+	end
+endmodule
@@ -1,41 +1,79 @@
 `ifndef _textbuffer_v_
 `define _textbuffer_v_
 
+/**
+ * Text RAM for the character cell display.
+ *
+ * Each cell is the character in the low seven bits, with inverse
+ * video in bit 7 and underline in bit 8.
+ *
+ * Rows are addressed through a base row pointer, so the screen can
+ * be scrolled by moving the pointer instead of copying the text.
+ * Row 0 on both the read and write ports is the row at base.
+ *
+ * Every cell has a valid bit, and cells that are not valid read as
+ * blanks.  Erasing any range of columns on any set of rows only
+ * clears the valid bits, so it takes one clock no matter how much
+ * of the screen it covers.
+ */
+
 module textbuffer(
 	input clk,
 
 	// read out
-	output reg [7:0] char,
-	output reg [2:0] subcol,
+	output [8:0] char,
+	output [2:0] subcol,
 	input [7:0] lcd_x, // 0 - 239 pixels
 	input [2:0] lcd_y,  // 0 - 7 lines
 
 	// write update
 	input write_strobe,
-	input [7:0] in,
-	input [4:0] write_x, // 0-39 column
-	input [2:0] write_y  // 0 - 7 lines
+	input [8:0] in,
+	input [5:0] write_x, // 0-39 column
+	input [2:0] write_y,  // 0 - 7 lines
+
+	// erase columns start to end (inclusive) on each row in the mask
+	input erase_strobe,
+	input [7:0] erase_rows,
+	input [5:0] erase_start,
+	input [5:0] erase_end,
+
+	// physical row that is shown at the top
+	input [2:0] base
 );
 
 	// the text buffer is 40x8 on screen, but stored 64x8
-	reg [7:0] text[64*8-1:0];
+	reg [8:0] text[64*8-1:0];
 	initial $readmemh("text.hex", text);
 
+	reg [63:0] valid[7:0];
+	integer row;
+	initial begin
+		for(row = 0 ; row < 8 ; row = row + 1)
+			valid[row] = ~64'h0;
+	end
+
 	// cheaper than a divide by six operation
 	reg [7:0] div6[255:0];
 	integer col;
 	initial begin
-		for(col = 0 ; col < 256 ; col++)
+		for(col = 0 ; col < 256 ; col = col + 1)
 			div6[col] <= col / 6;
 	end
 
 	reg [5:0] lcd_column;
 	reg [2:0] lcd_subcol;
-	wire [8:0] lcd_pos = { lcd_y, lcd_column };
-	assign char = text[lcd_pos];
+	wire [2:0] lcd_row = lcd_y + base;
+	wire [8:0] lcd_pos = { lcd_row, lcd_column };
+	assign char = valid[lcd_row][lcd_column] ? text[lcd_pos] : " ";
 	assign subcol = lcd_subcol;
 
-	wire [8:0] write_pos = { write_y, write_x };
+	wire [2:0] write_row = write_y + base;
+	wire [8:0] write_pos = { write_row, write_x };
+
+	wire [63:0] erase_mask =
+		  ((~64'h0) << erase_start)
+		& ((~64'h0) >> (63 - erase_end));
 
 	always @(posedge clk)
 	begin
@@ -43,8 +81,18 @@ module textbuffer(
 		lcd_column <= div6[lcd_x];
 		lcd_subcol <= lcd_x - (div6[lcd_x] * 6);
 
+		// erase rows counted from the base, then any write
+		// to the same row wins for its one cell
+		for(row = 0 ; row < 8 ; row = row + 1)
+			if (erase_strobe && erase_rows[row[2:0] - base])
+				valid[row] <= valid[row] & ~erase_mask;
+
 		// update the text at the write position
-		if (write_strobe)
+		if (write_strobe) begin
 			text[write_pos] <= in;
+			valid[write_row][write_x] <= 1;
+		end
 	end
 endmodule
+
+`endif
@@ -3,6 +3,8 @@
 `include "uart.v"
 `include "font.v"
 `include "textbuffer.v"
+`include "framebuffer.v"
+`include "vt100.v"
 `include "spi_display.v"
 
 module top(
@@ -64,46 +66,91 @@ module top(
 	wire clk = clk_48mhz;
 
 	reg lcd_frame_strobe = 1;
+
+	// regions of the display that need to be redrawn, set by the
+	// writers below and cleared by the lcd module as it draws them
+	reg [39:0] lcd_dirty = ~40'h0;
+	wire [39:0] lcd_clean;
+	wire [39:0] text_dirty;
+	wire [39:0] uart_dirty;
+	wire [39:0] spi_dirty;
 	wire [7:0] lcd_x;
 	wire [2:0] lcd_y;
 	wire [2:0] lcd_subcol;
-	wire [7:0] lcd_char;
-
-	reg [63:0] framebuffer[239:0];
-	initial $readmemh("fb.hex", framebuffer);
+	wire [8:0] lcd_char;
+
+	// the bitmap mode framebuffer, written by the serial port
+	// and the SPI display interface below
+	wire fb_write_strobe;
+	wire [7:0] fb_write_x;
+	wire [2:0] fb_write_y;
+	wire [7:0] fb_write_data;
+	wire [7:0] fb_write_mask;
+	wire [7:0] fb_pixels;
+
+	framebuffer fb(
+		.clk(clk),
+		.read_x(lcd_x),
+		.read_y(lcd_y),
+		.read_data(fb_pixels),
+		.write_strobe(fb_write_strobe),
+		.write_x(fb_write_x),
+		.write_y(fb_write_y),
+		.write_data(fb_write_data),
+		.write_mask(fb_write_mask)
+	);
 
 `ifdef TEXT_MODE
+	// written by the vt100 module from the serial port
+	wire text_write_strobe;
+	wire [8:0] text_write_data;
+	wire [5:0] text_write_x;
+	wire [2:0] text_write_y;
+	wire text_erase_strobe;
+	wire [7:0] text_erase_rows;
+	wire [5:0] text_erase_start;
+	wire [5:0] text_erase_end;
+	wire [2:0] text_base;
+
 	textbuffer tb(
 		.clk(clk),
 		.char(lcd_char),
 		.subcol(lcd_subcol),
 		.lcd_x(lcd_x),
 		.lcd_y(lcd_y),
-		.write_strobe(0)
+		.write_strobe(text_write_strobe),
+		.in(text_write_data),
+		.write_x(text_write_x),
+		.write_y(text_write_y),
+		.erase_strobe(text_erase_strobe),
+		.erase_rows(text_erase_rows),
+		.erase_start(text_erase_start),
+		.erase_end(text_erase_end),
+		.base(text_base)
 	);
 
-	wire inverted_video = lcd_char[7];
-	wire [7:0] pixels;
+	wire [7:0] font_pixels;
 
 	font_5x7 font(
 		.clk(clk),
-		.pixels(pixels),
+		.pixels(font_pixels),
 		.character(lcd_char[6:0]),
 		.col(lcd_subcol)
 	);
-`else
 
-	wire [63:0] fb = framebuffer[lcd_x];
-	wire [7:0] pixels = {
-		fb[{lcd_y, 3'h7}],
-		fb[{lcd_y, 3'h6}],
-		fb[{lcd_y, 3'h5}],
-		fb[{lcd_y, 3'h4}],
-		fb[{lcd_y, 3'h3}],
-		fb[{lcd_y, 3'h2}],
-		fb[{lcd_y, 3'h1}],
-		fb[{lcd_y, 3'h0}]
-	};
+	// the attributes are delayed to line up with the font output;
+	// underline is the bottom row of the cell and inverse flips it
+	reg inverted_video;
+	reg underline;
+	always @(posedge clk) begin
+		inverted_video <= lcd_char[7];
+		underline <= lcd_char[8];
+	end
+
+	wire [7:0] pixels = (font_pixels | { underline, 7'b0 })
+		^ { 8{inverted_video} };
+`else
+	wire [7:0] pixels = fb_pixels;
 	//wire [7:0] pixels = lcd_x;
 `endif
 
@@ -144,11 +191,12 @@ module top(
 	lcd modell100_lcd(
 		.clk(clk),
 		.reset(reset),
-		//.pixels(inverted_video ? ~pixels : pixels),
 		.pixels(pixels),
 		.x(lcd_x),
 		.y(lcd_y),
 		.frame_strobe(lcd_frame_strobe),
+		.dirty(lcd_dirty),
+		.clean(lcd_clean),
 		.data_pin(lcd_data),
 		.cs_pin(lcd_cs),
 		.cs1_pin(lcd_cs1),
@@ -158,6 +206,12 @@ module top(
 		.reset_pin(lcd_reset)
 	);
 
+	always @(posedge clk)
+		lcd_dirty <= (lcd_dirty & ~lcd_clean)
+			| text_dirty
+			| uart_dirty
+			| spi_dirty;
+
 	reg [31:0] dim;
 	always @(posedge clk) dim <= dim + 1;
 
@@ -215,17 +269,6 @@ module top(
 	wire uart_rxd_strobe;
 	reg [7:0] x;
 	reg [2:0] y;
-	wire [63:0] wr_fb = framebuffer[x];
-	wire [7:0] wr_pixels = {
-		wr_fb[{y, 3'h7}],
-		wr_fb[{y, 3'h6}],
-		wr_fb[{y, 3'h5}],
-		wr_fb[{y, 3'h4}],
-		wr_fb[{y, 3'h3}],
-		wr_fb[{y, 3'h2}],
-		wr_fb[{y, 3'h1}],
-		wr_fb[{y, 3'h0}]
-	};
 
 	reg uart_txd_strobe;
 	reg uart_txd_ready;
@@ -250,6 +293,80 @@ module top(
 		.data_strobe(uart_rxd_strobe)
 	);
 
+`ifdef TEXT_MODE
+	// serial bytes are queued and then parsed and drawn as text
+	// by the vt100 engine
+	wire text_available;
+	wire [7:0] text_data;
+	wire text_strobe;
+
+	fifo #(.NUM(256)) text_fifo(
+		.clk(clk),
+		.reset(reset),
+		.data_available(text_available),
+		.write_data(uart_rxd),
+		.write_strobe(uart_rxd_strobe),
+		.read_data(text_data),
+		.read_strobe(text_strobe)
+	);
+
+	vt100 text_writer(
+		.clk(clk),
+		.reset(reset),
+		.in_available(text_available),
+		.in_data(text_data),
+		.in_strobe(text_strobe),
+		.write_strobe(text_write_strobe),
+		.write_data(text_write_data),
+		.write_x(text_write_x),
+		.write_y(text_write_y),
+		.erase_strobe(text_erase_strobe),
+		.erase_rows(text_erase_rows),
+		.erase_start(text_erase_start),
+		.erase_end(text_erase_end),
+		.base(text_base)
+	);
+
+	// a written cell can straddle two chips.  an erase redraws
+	// the pages of the rows in it, and a scroll moves every row,
+	// so a change of base redraws all of them.
+	function [39:0] text_rows_dirty;
+		input [7:0] rows;
+		integer r;
+	begin
+		text_rows_dirty = 0;
+		for(r = 0 ; r < 8 ; r = r + 1)
+			if (rows[r])
+				text_rows_dirty = text_rows_dirty
+					| 40'h1F << ((r % 4) * 10 + (r >= 4 ? 5 : 0));
+	end
+	endfunction
+
+	reg [2:0] text_base_drawn = 0;
+	always @(posedge clk)
+		text_base_drawn <= text_base;
+
+	wire [39:0] text_dirty_start;
+	wire [39:0] text_dirty_end;
+	lcd_region text_region_start(
+		.x(text_write_x * 6),
+		.y(text_write_y),
+		.mask(text_dirty_start)
+	);
+	lcd_region text_region_end(
+		.x(text_write_x * 6 + 5),
+		.y(text_write_y),
+		.mask(text_dirty_end)
+	);
+
+	assign text_dirty =
+		  (text_base != text_base_drawn ? ~40'h0 : 40'h0)
+		| (text_erase_strobe ? text_rows_dirty(text_erase_rows) : 40'h0)
+		| (text_write_strobe ? text_dirty_start | text_dirty_end : 40'h0);
+`else
+	assign text_dirty = 0;
+`endif
+
 	reg lcd_output = 1;
 	wire [7:0] key_row;
 	wire [7:0] key_col_pin = lcd_cs[7:0];
@@ -306,22 +423,32 @@ module top(
 */
 
 `ifdef UART_FB
+	wire [39:0] uart_region;
+	lcd_region uart_dirty_region(
+		.x(x),
+		.y(y),
+		.mask(uart_region)
+	);
+	assign uart_dirty = uart_rxd_strobe ? uart_region : 0;
+
+	// a whole byte at the serial write position
+	wire uart_fb_write = uart_rxd_strobe;
+	wire [7:0] uart_fb_data = {
+		uart_rxd[0],
+		uart_rxd[1],
+		uart_rxd[2],
+		uart_rxd[3],
+		uart_rxd[4],
+		uart_rxd[5],
+		uart_rxd[6],
+		uart_rxd[7]
+	};
+
 	always @(posedge clk)
 	begin
 		led_r <= 1;
 		if (uart_rxd_strobe) begin
 			led_r <= 0;
-			framebuffer[x][8*y +: 8] <= {
-				uart_rxd[0],
-				uart_rxd[1],
-				uart_rxd[2],
-				uart_rxd[3],
-				uart_rxd[4],
-				uart_rxd[5],
-				uart_rxd[6],
-				uart_rxd[7]
-			};
-
 			y <= y + 1;
 			if (y == 7) begin
 				if (x == 239)
@@ -331,6 +458,10 @@ module top(
 			end
 		end
 	end
+`else
+	assign uart_dirty = 0;
+	wire uart_fb_write = 0;
+	wire [7:0] uart_fb_data = 0;
 `endif
 
 	// interface with the Raspiberry Pi SPI TFT library
@@ -342,14 +473,6 @@ module top(
 	wire [5:0] spi_tft_g = spi_tft_pixels[10:5];
 	wire [4:0] spi_tft_b = spi_tft_pixels[4:0];
 
-	// 240 x 64
-/*
-	wire [63:0] spi_framebuffer_col = framebuffer[spi_tft_x[7:0]];
-	wire spi_frame_buffer_pixel = spi_framebuffer_col[spi_tft_y[5:0]];
-*/
-	wire [63:0] spi_framebuffer_col = framebuffer[128];
-	wire spi_frame_buffer_pixel = spi_framebuffer_col[spi_tft_y[5:0]];
-
 	wire spi_dc = gpio_2;
 	wire spi_clk = gpio_46;
 	wire spi_cs = gpio_47;
@@ -419,6 +542,18 @@ module top(
 		.y(spi_tft_y)
 	);
 
+	// pixels from the SPI clock domain, converted to monochrome if
+	// any of the top bits of the RGB pixel are set.  they are written
+	// into the fifo on the same SPI clock edge as the strobe, since
+	// the SPI clock stops between transfers.
+	wire spi_pixel_strobe = spi_tft_strobe
+		&& spi_tft_x < 240 && spi_tft_y < 64;
+	wire [14:0] spi_pixel_data = {
+		spi_tft_x[7:0],
+		spi_tft_y[5:0],
+		spi_tft_r[4] | spi_tft_g[5] | spi_tft_b[4]
+	};
+
 	always @(posedge spi_clk)
 	begin
 		led_r <= 1;
@@ -428,15 +563,46 @@ module top(
 		if (spi_tft_strobe)
 		begin
 			//led_r <= 0;
-
-			// convert to monochrome if any of the top bits
-			// of the RGB pixel are set
-			if (spi_tft_x < 240 && spi_tft_y < 64)
-			framebuffer[spi_tft_x[7:0]][spi_tft_y[5:0]] <=
-				spi_tft_r[4] | spi_tft_g[5] | spi_tft_b[4];
 		end
 	end
 
+	// the pixels cross into the main clock through a fifo, then
+	// take turns with the serial port for the framebuffer's write
+	// port.  the serial port only writes every few hundred clocks,
+	// so the fifo never has to wait long.
+	wire spi_pixel_available;
+	wire [14:0] spi_pixel;
+	wire spi_pixel_read = spi_pixel_available && !uart_fb_write;
+	wire [7:0] spi_pixel_x = spi_pixel[14:7];
+	wire [5:0] spi_pixel_y = spi_pixel[6:1];
+	wire [7:0] spi_pixel_mask = 8'h01 << spi_pixel_y[2:0];
+	wire [39:0] spi_region;
+
+	async_fifo #(.WIDTH(15), .NUM(16)) spi_fifo(
+		.reset(reset),
+		.write_clk(spi_clk),
+		.write_data(spi_pixel_data),
+		.write_strobe(spi_pixel_strobe),
+		.read_clk(clk),
+		.data_available(spi_pixel_available),
+		.read_data(spi_pixel),
+		.read_strobe(spi_pixel_read)
+	);
+
+	lcd_region spi_dirty_region(
+		.x(spi_pixel_x),
+		.y(spi_pixel_y[5:3]),
+		.mask(spi_region)
+	);
+	assign spi_dirty = spi_pixel_read ? spi_region : 0;
+
+	assign fb_write_strobe = uart_fb_write || spi_pixel_read;
+	assign fb_write_x = uart_fb_write ? x : spi_pixel_x;
+	assign fb_write_y = uart_fb_write ? y : spi_pixel_y[5:3];
+	assign fb_write_data = uart_fb_write ? uart_fb_data
+		: { 8{spi_pixel[0]} };
+	assign fb_write_mask = uart_fb_write ? 8'hFF : spi_pixel_mask;
+
 	// generate a 1/4 duty cycle wave for the
 	// negative voltage charge pump circuit
 	pwm negative_charge_pump(
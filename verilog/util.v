@@ -4,7 +4,7 @@
 `ifndef util_v
 `define util_v
 
-`define CLOG2(x) \
+`define CLOG2(x) ( \
    x <= 2	 ? 1 : \
    x <= 4	 ? 2 : \
    x <= 8	 ? 3 : \
@@ -21,7 +21,7 @@
    x <= 16384	 ? 14 : \
    x <= 32768	 ? 15 : \
    x <= 65536	 ? 16 : \
-   -1
+   -1 )
 
 function [7:0] hexdigit;
 	input [3:0] x;
@@ -109,6 +109,88 @@ module fifo(
 endmodule
 
 
+/*
+ * A fifo between two clock domains.
+ *
+ * The pointers are passed to the other side in gray code through two
+ * flip-flops, so each side sees a pointer that is late but never
+ * torn.  The extra pointer bit tells a full fifo from an empty one.
+ * Writes while full are dropped.  NUM must be a power of two.
+ */
+module async_fifo(
+	input reset,
+
+	input write_clk,
+	input [WIDTH-1:0] write_data,
+	input write_strobe,
+	output full,
+
+	input read_clk,
+	output data_available,
+	output [WIDTH-1:0] read_data,
+	input read_strobe
+);
+	parameter WIDTH = 8;
+	parameter NUM = 16;
+
+	localparam BITS = `CLOG2(NUM);
+
+	reg [WIDTH-1:0] buffer[0:NUM-1];
+
+	reg [BITS:0] write_ptr = 0;
+	reg [BITS:0] write_gray = 0;
+	reg [BITS:0] write_gray_sync0 = 0;
+	reg [BITS:0] write_gray_sync1 = 0;
+
+	reg [BITS:0] read_ptr = 0;
+	reg [BITS:0] read_gray = 0;
+	reg [BITS:0] read_gray_sync0 = 0;
+	reg [BITS:0] read_gray_sync1 = 0;
+
+	wire [BITS:0] write_next = write_ptr + 1;
+	wire [BITS:0] read_next = read_ptr + 1;
+
+	// full when the writer is a whole lap ahead of the reader,
+	// which in gray code flips the top two bits
+	assign full = write_gray == {
+		~read_gray_sync1[BITS:BITS-1],
+		read_gray_sync1[BITS-2:0]
+	};
+
+	assign data_available = read_gray != write_gray_sync1;
+	assign read_data = buffer[read_ptr[BITS-1:0]];
+
+	always @(posedge write_clk) begin
+		read_gray_sync0 <= read_gray;
+		read_gray_sync1 <= read_gray_sync0;
+
+		if (reset) begin
+			write_ptr <= 0;
+			write_gray <= 0;
+		end else
+		if (write_strobe && !full) begin
+			buffer[write_ptr[BITS-1:0]] <= write_data;
+			write_ptr <= write_next;
+			write_gray <= write_next ^ (write_next >> 1);
+		end
+	end
+
+	always @(posedge read_clk) begin
+		write_gray_sync0 <= write_gray;
+		write_gray_sync1 <= write_gray_sync0;
+
+		if (reset) begin
+			read_ptr <= 0;
+			read_gray <= 0;
+		end else
+		if (read_strobe) begin
+			read_ptr <= read_next;
+			read_gray <= read_next ^ (read_next >> 1);
+		end
+	end
+endmodule
+
+
 
 /************************************************************************
  *
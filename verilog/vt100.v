@@ -0,0 +1,437 @@
+`ifndef _vt100_v_
+`define _vt100_v_
+
+/**
+ * VT100 escape sequence engine for the text buffer.
+ *
+ * Bytes are taken one at a time from a fifo, parsed, and turned into
+ * writes and erases of the textbuffer.  Printable characters are
+ * written at the cursor with the current attributes.  Like a real
+ * vt100 the cursor stays on the last column after it is written, and
+ * the line only wraps when another character follows.
+ *
+ * Supported controls are CR, LF, VT, FF, backspace and tab, and
+ * these escape sequences:
+ *
+ * ESC c		reset
+ * ESC 7, ESC 8		save and restore the cursor and attributes
+ * ESC D, ESC E, ESC M	index, next line, reverse index
+ * CSI r;c H, CSI r;c f	cursor position
+ * CSI n A/B/C/D	cursor up, down, right, left
+ * CSI n J		erase in display, 0 to the end, 1 from the start, 2 all
+ * CSI n K		erase in line, the same
+ * CSI n S, CSI n T	scroll up, down
+ * CSI n;... m		attributes, 0 normal, 1 bold, 4 underline, 7 inverse,
+ *			22 not bold, 24 not underlined, 27 not inverse
+ *
+ * Bold is drawn as underline, since the font has no bold face.  The
+ * SGR parameters are applied one at a time as they end, so there can
+ * be any number of them; the other sequences only keep the first two.
+ *
+ * Other CSI sequences are parsed and ignored, including private ones
+ * like CSI ? 1 h.  Other escapes are ignored up to their final byte,
+ * so the intermediates in ESC ( B or ESC # 8 do not leave the final
+ * to be run on its own.  OSC, DCS, SOS, PM and APC strings like
+ * ESC ] 0;title BEL are skipped up to BEL or ST, ESC \, and the
+ * controls in them are not executed.
+ *
+ * The whole screen scrolls by moving the textbuffer's base row and
+ * erasing the rows that come into view, and erases only clear valid
+ * bits, so every byte is handled in two or three clocks no matter
+ * what is on the screen.  ROWS must be the 8 rows of the text RAM
+ * for the scrolling to wrap around correctly.
+ */
+
+module vt100(
+	input clk,
+	input reset,
+
+	// input bytes from the fifo
+	input in_available,
+	input [7:0] in_data,
+	output reg in_strobe,
+
+	// output to the textbuffer
+	output reg write_strobe,
+	output reg [8:0] write_data,
+	output reg [5:0] write_x,
+	output reg [2:0] write_y,
+	output reg erase_strobe,
+	output reg [7:0] erase_rows,
+	output reg [5:0] erase_start,
+	output reg [5:0] erase_end,
+	output reg [2:0] base
+);
+	parameter COLS = 40;
+	parameter ROWS = 8;
+
+	localparam STATE_IDLE	= 0;
+	localparam STATE_CHAR	= 1;
+	localparam STATE_ERASE	= 2;
+
+	// parser modes
+	localparam MODE_GROUND	= 0;
+	localparam MODE_ESCAPE	= 1;
+	localparam MODE_CSI	= 2;
+	localparam MODE_IGNORE	= 3; // rest of an unsupported CSI
+	localparam MODE_ESC_IGNORE = 4; // rest of an escape with intermediates
+	localparam MODE_STRING	= 5; // OSC, DCS etc, until BEL or ST
+
+	localparam ATTR_INVERSE	= 3'b001;
+	localparam ATTR_UNDERLINE = 3'b010;
+	localparam ATTR_BOLD	= 3'b100;
+
+	reg [1:0] state;
+	reg [2:0] mode;
+	reg [7:0] c;
+
+	// cursor position, x == COLS when a wrap is pending
+	reg [5:0] x;
+	reg [2:0] y;
+	reg [2:0] attr;
+	wire [5:0] x_col = x == COLS ? COLS-1 : x;
+
+	reg [5:0] saved_x;
+	reg [2:0] saved_y;
+	reg [2:0] saved_attr;
+
+	// the first two CSI parameters, saturating at 255; any more
+	// are skipped once param_count reaches 2
+	reg [7:0] p0;
+	reg [7:0] p1;
+	reg [1:0] param_count;
+	wire [11:0] param_next = (param_count[0] ? p1 : p0) * 10 + (c - "0");
+	wire [7:0] param_digit = param_next > 255 ? 255 : param_next;
+
+	// the parameter being read, whichever one it is, saturating the
+	// same way, and the attributes with the SGR parameters before it
+	// already applied
+	reg [7:0] pn;
+	reg [2:0] sgr_attr;
+	wire [11:0] pn_next = pn * 10 + (c - "0");
+	wire [7:0] pn_digit = pn_next > 255 ? 255 : pn_next;
+
+	// parameters with 0 or missing meaning 1
+	wire [7:0] n0 = p0 == 0 ? 1 : p0;
+	wire [7:0] n1 = p1 == 0 ? 1 : p1;
+
+	// rows from the cursor down, and above it, for the erases
+	wire [7:0] rows_below = ~8'h00 << (y + 1);
+	wire [7:0] rows_above = ~(~8'h00 << y);
+
+	// attributes after applying one SGR parameter
+	function [2:0] sgr;
+		input [2:0] attr;
+		input [7:0] p;
+	begin
+		case(p)
+		0: sgr = 0;
+		1: sgr = attr | ATTR_BOLD;
+		4: sgr = attr | ATTR_UNDERLINE;
+		7: sgr = attr | ATTR_INVERSE;
+		22: sgr = attr & ~ATTR_BOLD;
+		24: sgr = attr & ~ATTR_UNDERLINE;
+		27: sgr = attr & ~ATTR_INVERSE;
+		default: sgr = attr; // colors, blink, etc
+		endcase
+	end
+	endfunction
+
+	// a second erase for the J sequences, done on the next clock
+	reg [7:0] erase2_rows;
+	reg [5:0] erase2_start;
+	reg [5:0] erase2_end;
+
+	// erase columns start to end of the rows in the mask
+	task erase;
+		input [7:0] rows;
+		input [5:0] start;
+		input [5:0] stop;
+	begin
+		erase_strobe <= 1;
+		erase_rows <= rows;
+		erase_start <= start;
+		erase_end <= stop;
+	end
+	endtask
+
+	// scroll the whole screen up by n rows, blanking the bottom
+	task scroll_up;
+		input [7:0] n;
+	begin
+		if (n >= ROWS) begin
+			erase(8'hFF, 0, COLS-1);
+		end else begin
+			base <= base + n;
+			erase(~8'h00 << (ROWS - n), 0, COLS-1);
+		end
+	end
+	endtask
+
+	// scroll the whole screen down by n rows, blanking the top
+	task scroll_down;
+		input [7:0] n;
+	begin
+		if (n >= ROWS) begin
+			erase(8'hFF, 0, COLS-1);
+		end else begin
+			base <= base - n;
+			erase(~(~8'h00 << n), 0, COLS-1);
+		end
+	end
+	endtask
+
+	// down one line, scrolling at the bottom
+	task linefeed;
+	begin
+		if (y == ROWS-1)
+			scroll_up(1);
+		else
+			y <= y + 1;
+	end
+	endtask
+
+	// up one line, scrolling at the top
+	task reverse_linefeed;
+	begin
+		if (y == 0)
+			scroll_down(1);
+		else
+			y <= y - 1;
+	end
+	endtask
+
+	always @(posedge clk)
+	begin
+		in_strobe <= 0;
+		write_strobe <= 0;
+		erase_strobe <= 0;
+
+		if (reset) begin
+			state <= STATE_IDLE;
+			mode <= MODE_GROUND;
+			x <= 0;
+			y <= 0;
+			attr <= 0;
+			base <= 0;
+		end else
+		case(state)
+		STATE_IDLE: begin
+			// the read strobe takes a clock to reach the fifo,
+			// so the next byte is not looked at until this one
+			// has been handled.
+			if (in_available) begin
+				c <= in_data;
+				in_strobe <= 1;
+				state <= STATE_CHAR;
+			end
+		end
+		STATE_ERASE: begin
+			erase(erase2_rows, erase2_start, erase2_end);
+			state <= STATE_IDLE;
+		end
+		STATE_CHAR: begin
+			state <= STATE_IDLE;
+
+			if (c == 8'h7F) begin
+				// DEL is ignored everywhere
+			end else
+			if (c == 8'h18 || c == 8'h1A) begin
+				// CAN and SUB abort any sequence
+				mode <= MODE_GROUND;
+			end else
+			if (c == 8'h1B) begin
+				// also the start of ST inside a string
+				mode <= MODE_ESCAPE;
+			end else
+			if (mode == MODE_STRING) begin
+				// nothing in a string is drawn or executed
+				if (c == 8'h07)
+					mode <= MODE_GROUND;
+			end else
+			if (c < 8'h20) begin
+				// controls are executed even inside sequences
+				if (c == "\r") begin
+					x <= 0;
+				end else
+				if (c == "\n" || c == 8'h0B || c == 8'h0C) begin
+					// treated as CR LF, as on the AVR
+					x <= 0;
+					linefeed();
+				end else
+				if (c == 8'h08) begin
+					// backspace without erasing
+					if (x == COLS)
+						x <= COLS-2;
+					else
+					if (x != 0)
+						x <= x - 1;
+				end else
+				if (c == "\t") begin
+					// tab stops every eight columns
+					if ((x | 7) >= COLS-1)
+						x <= COLS-1;
+					else
+						x <= (x | 7) + 1;
+				end
+			end else
+			case(mode)
+			MODE_GROUND: begin
+				if (c[7]) begin
+					// there are no glyphs for 8-bit codes
+				end else
+				if (x == COLS) begin
+					// wrap first, then come back to draw it
+					x <= 0;
+					linefeed();
+					state <= STATE_CHAR;
+				end else begin
+					write_strobe <= 1;
+					// underline, inverse; bold is
+					// drawn as underline
+					write_data <= {
+						attr[2] | attr[1],
+						attr[0],
+						c[6:0]
+					};
+					write_x <= x;
+					write_y <= y;
+					x <= x + 1;
+				end
+			end
+			MODE_ESCAPE: begin
+				mode <= MODE_GROUND;
+
+				case(c)
+				"[": begin
+					mode <= MODE_CSI;
+					p0 <= 0;
+					p1 <= 0;
+					param_count <= 0;
+					pn <= 0;
+					sgr_attr <= attr;
+				end
+				"c": begin
+					x <= 0;
+					y <= 0;
+					attr <= 0;
+					base <= 0;
+					erase(8'hFF, 0, COLS-1);
+				end
+				"7": begin
+					saved_x <= x_col;
+					saved_y <= y;
+					saved_attr <= attr;
+				end
+				"8": begin
+					x <= saved_x;
+					y <= saved_y;
+					attr <= saved_attr;
+				end
+				"D": begin
+					x <= x_col;
+					linefeed();
+				end
+				"E": begin
+					x <= 0;
+					linefeed();
+				end
+				"M": begin
+					x <= x_col;
+					reverse_linefeed();
+				end
+				"]", "P", "X", "^", "_": begin
+					mode <= MODE_STRING;
+				end
+				default: begin
+					// intermediates like ESC ( B wait
+					// for their final character; the
+					// \ of an ST ends up here too
+					if (c < 8'h30)
+						mode <= MODE_ESC_IGNORE;
+				end
+				endcase
+			end
+			MODE_CSI: begin
+				if ("0" <= c && c <= "9") begin
+					if (param_count == 0)
+						p0 <= param_digit;
+					else
+					if (param_count == 1)
+						p1 <= param_digit;
+					pn <= pn_digit;
+				end else
+				if (c == ";") begin
+					if (param_count != 2)
+						param_count <= param_count + 1;
+					pn <= 0;
+					sgr_attr <= sgr(sgr_attr, pn);
+				end else
+				if (c < 8'h40) begin
+					// private markers and intermediates
+					mode <= MODE_IGNORE;
+				end else begin
+					mode <= MODE_GROUND;
+
+					case(c)
+					"H", "f": begin
+						x <= n1 > COLS ? COLS-1 : n1 - 1;
+						y <= n0 > ROWS ? ROWS-1 : n0 - 1;
+					end
+					"A": begin
+						y <= n0 > y ? 0 : y - n0;
+						x <= x_col;
+					end
+					"B": begin
+						y <= y + n0 >= ROWS ? ROWS-1 : y + n0;
+						x <= x_col;
+					end
+					"C": x <= x_col + n0 >= COLS ? COLS-1 : x_col + n0;
+					"D": x <= n0 > x_col ? 0 : x_col - n0;
+					"J": case(p0)
+						0: begin
+							erase(8'h01 << y, x_col, COLS-1);
+							erase2_rows <= rows_below;
+							erase2_start <= 0;
+							erase2_end <= COLS-1;
+							state <= STATE_ERASE;
+						end
+						1: begin
+							erase(8'h01 << y, 0, x_col);
+							erase2_rows <= rows_above;
+							erase2_start <= 0;
+							erase2_end <= COLS-1;
+							state <= STATE_ERASE;
+						end
+						2: erase(8'hFF, 0, COLS-1);
+						default: ;
+					endcase
+					"K": case(p0)
+						0: erase(8'h01 << y, x_col, COLS-1);
+						1: erase(8'h01 << y, 0, x_col);
+						2: erase(8'h01 << y, 0, COLS-1);
+						default: ;
+					endcase
+					"S": scroll_up(n0);
+					"T": scroll_down(n0);
+					"m": attr <= sgr(sgr_attr, pn);
+					default: ;
+					endcase
+				end
+			end
+			MODE_IGNORE: begin
+				if (c >= 8'h40)
+					mode <= MODE_GROUND;
+			end
+			MODE_ESC_IGNORE: begin
+				if (c >= 8'h30)
+					mode <= MODE_GROUND;
+			end
+			default: ;
+			endcase
+		end
+		endcase
+	end
+endmodule
+
+`endif
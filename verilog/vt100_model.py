@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+"""
+Reference model of vt100.v, for the expected screen of vt100_tb.
+
+    vt100_model.py vt100_tb.hex > vt100_tb_screen.hex
+
+Reads the byte stream in the same hex format that the testbench
+loads with $readmemh, runs it through a plain Python copy of the
+escape sequence engine, and prints the text RAM as the testbench
+sees it: one line of 40 cells per row, top row first, with the
+underline and inverse attributes in bits 8 and 7.
+
+This has to be kept in step with vt100.v by hand.  It follows the
+same rules, including the ones that differ from a real vt100: LF, VT
+and FF also return the carriage, only the first two parameters are
+kept for everything but SGR, and parameters saturate at 255.
+"""
+import sys
+
+COLS = 40
+ROWS = 8
+
+ATTR_INVERSE = 1
+ATTR_UNDERLINE = 2
+ATTR_BOLD = 4
+
+
+def die(msg):
+    sys.stderr.write("vt100_model: %s\n" % msg)
+    sys.exit(1)
+
+
+def read_hex(name):
+    data = bytearray()
+    for line in open(name):
+        line = line.split("//")[0]
+        for word in line.split():
+            data.append(int(word, 16))
+    return data
+
+
+def sgr(attr, p):
+    if p == 0:
+        return 0
+    if p == 1:
+        return attr | ATTR_BOLD
+    if p == 4:
+        return attr | ATTR_UNDERLINE
+    if p == 7:
+        return attr | ATTR_INVERSE
+    if p == 22:
+        return attr & ~ATTR_BOLD
+    if p == 24:
+        return attr & ~ATTR_UNDERLINE
+    if p == 27:
+        return attr & ~ATTR_INVERSE
+    return attr
+
+
+class Terminal:
+    def __init__(self):
+        self.screen = [self.blank_row() for _ in range(ROWS)]
+        self.x = 0  # COLS when a wrap is pending
+        self.y = 0
+        self.attr = 0
+        self.saved = (0, 0, 0)
+        self.mode = "ground"
+
+    @staticmethod
+    def blank_row():
+        return [(0, " ")] * COLS
+
+    def x_col(self):
+        return COLS - 1 if self.x == COLS else self.x
+
+    def erase(self, row, start, end):
+        for col in range(start, end + 1):
+            self.screen[row][col] = (0, " ")
+
+    def scroll_up(self, n):
+        for _ in range(min(n, ROWS)):
+            self.screen.pop(0)
+            self.screen.append(self.blank_row())
+
+    def scroll_down(self, n):
+        for _ in range(min(n, ROWS)):
+            self.screen.pop()
+            self.screen.insert(0, self.blank_row())
+
+    def linefeed(self):
+        if self.y == ROWS - 1:
+            self.scroll_up(1)
+        else:
+            self.y += 1
+
+    def reverse_linefeed(self):
+        if self.y == 0:
+            self.scroll_down(1)
+        else:
+            self.y -= 1
+
+    def control(self, c):
+        if c == 0x0D:
+            self.x = 0
+        elif c in (0x0A, 0x0B, 0x0C):
+            self.x = 0
+            self.linefeed()
+        elif c == 0x08:
+            if self.x == COLS:
+                self.x = COLS - 2
+            elif self.x:
+                self.x -= 1
+        elif c == 0x09:
+            self.x = min(COLS - 1, (self.x | 7) + 1)
+
+    def print(self, c):
+        if c & 0x80:
+            return
+        if self.x == COLS:
+            self.x = 0
+            self.linefeed()
+        self.screen[self.y][self.x] = (self.attr, chr(c))
+        self.x += 1
+
+    def escape(self, c):
+        self.mode = "ground"
+        ch = chr(c)
+        if ch == "[":
+            self.mode = "csi"
+            self.params = [0]
+            self.sgr_attr = self.attr
+        elif ch == "c":
+            self.screen = [self.blank_row() for _ in range(ROWS)]
+            self.x = self.y = self.attr = 0
+        elif ch == "7":
+            self.saved = (self.x_col(), self.y, self.attr)
+        elif ch == "8":
+            self.x, self.y, self.attr = self.saved
+        elif ch == "D":
+            self.x = self.x_col()
+            self.linefeed()
+        elif ch == "E":
+            self.x = 0
+            self.linefeed()
+        elif ch == "M":
+            self.x = self.x_col()
+            self.reverse_linefeed()
+        elif ch in "]PX^_":
+            self.mode = "string"
+        elif c < 0x30:
+            self.mode = "escape intermediate"
+
+    def csi(self, c):
+        ch = chr(c)
+        if ch.isdigit():
+            self.params[-1] = min(255, self.params[-1] * 10 + int(ch))
+            return
+        if ch == ";":
+            self.sgr_attr = sgr(self.sgr_attr, self.params[-1])
+            self.params.append(0)
+            return
+        if c < 0x40:
+            self.mode = "csi ignore"
+            return
+
+        self.mode = "ground"
+        p0 = self.params[0]
+        p1 = self.params[1] if len(self.params) > 1 else 0
+        n0 = p0 or 1
+        n1 = p1 or 1
+
+        if ch in "Hf":
+            self.x = min(n1, COLS) - 1
+            self.y = min(n0, ROWS) - 1
+        elif ch == "A":
+            self.y = max(0, self.y - n0)
+            self.x = self.x_col()
+        elif ch == "B":
+            self.y = min(ROWS - 1, self.y + n0)
+            self.x = self.x_col()
+        elif ch == "C":
+            self.x = min(COLS - 1, self.x_col() + n0)
+        elif ch == "D":
+            self.x = max(0, self.x_col() - n0)
+        elif ch == "J":
+            if p0 == 0:
+                self.erase(self.y, self.x_col(), COLS - 1)
+                for row in range(self.y + 1, ROWS):
+                    self.erase(row, 0, COLS - 1)
+            elif p0 == 1:
+                self.erase(self.y, 0, self.x_col())
+                for row in range(0, self.y):
+                    self.erase(row, 0, COLS - 1)
+            elif p0 == 2:
+                for row in range(ROWS):
+                    self.erase(row, 0, COLS - 1)
+        elif ch == "K":
+            if p0 == 0:
+                self.erase(self.y, self.x_col(), COLS - 1)
+            elif p0 == 1:
+                self.erase(self.y, 0, self.x_col())
+            elif p0 == 2:
+                self.erase(self.y, 0, COLS - 1)
+        elif ch == "S":
+            self.scroll_up(n0)
+        elif ch == "T":
+            self.scroll_down(n0)
+        elif ch == "m":
+            self.attr = sgr(self.sgr_attr, self.params[-1])
+
+    def byte(self, c):
+        if c == 0x7F:
+            return
+        if c in (0x18, 0x1A):
+            self.mode = "ground"
+            return
+        if c == 0x1B:
+            self.mode = "escape"
+            return
+        if self.mode == "string":
+            if c == 0x07:
+                self.mode = "ground"
+            return
+        if c < 0x20:
+            self.control(c)
+            return
+
+        if self.mode == "ground":
+            self.print(c)
+        elif self.mode == "escape":
+            self.escape(c)
+        elif self.mode == "escape intermediate":
+            if c >= 0x30:
+                self.mode = "ground"
+        elif self.mode == "csi":
+            self.csi(c)
+        elif self.mode == "csi ignore":
+            if c >= 0x40:
+                self.mode = "ground"
+
+
+def cell(attr, ch):
+    underline = 1 if attr & (ATTR_UNDERLINE | ATTR_BOLD) else 0
+    inverse = 1 if attr & ATTR_INVERSE else 0
+    return underline << 8 | inverse << 7 | ord(ch)
+
+
+def main(argv):
+    if len(argv) != 2:
+        die("usage: vt100_model.py stream.hex > screen.hex")
+
+    term = Terminal()
+    for c in read_hex(argv[1]):
+        term.byte(c)
+
+    print("// Expected text RAM after vt100_tb.hex, made by vt100_model.py;")
+    print("// 40 cells per row with the attributes in bits 8:7 (underline,")
+    print("// inverse)")
+    for row in term.screen:
+        text = "".join(ch for attr, ch in row).rstrip()
+        print(" ".join("%03x" % cell(attr, ch) for attr, ch in row), "//", text)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,149 @@
+/**
+ * Testbench for the vt100 escape sequence engine.
+ *
+ * Replays a captured byte stream through the vt100 module into a
+ * textbuffer and compares the text RAM, as seen through the base
+ * row and the valid bits, with the expected screen.
+ *
+ * The stream in vt100_tb.hex clears the screen, prints enough lines
+ * to scroll, wraps a long line, moves the cursor around, erases parts
+ * of lines and the screen, reverse indexes at the top, and draws with
+ * inverse and underline.  It also has the terminfo padding NULs and
+ * some private sequences that must be ignored, and ends with window
+ * titles and a DCS, with a CR LF inside one, ended by BEL and by ST,
+ * an ESC # 8 that must not restore the cursor, and SGR sequences
+ * with more than two parameters and with bold.
+ *
+ * The expected screen in vt100_tb_screen.hex is made from the stream
+ * by a Python model of the engine; after changing either one, run
+ *
+ *	./vt100_model.py vt100_tb.hex > vt100_tb_screen.hex
+ *
+ * Run with "make test".
+ */
+`include "textbuffer.v"
+`include "vt100.v"
+
+module vt100_tb;
+	parameter COLS = 40;
+	parameter ROWS = 8;
+
+	reg clk = 0;
+	reg reset = 1;
+	always #1 clk = ~clk;
+
+	reg [7:0] stream[0:4095];
+	reg [8:0] expected[0:COLS*ROWS-1];
+	integer len;
+	integer pos;
+
+	wire in_strobe;
+	wire write_strobe;
+	wire [8:0] write_data;
+	wire [5:0] write_x;
+	wire [2:0] write_y;
+	wire erase_strobe;
+	wire [7:0] erase_rows;
+	wire [5:0] erase_start;
+	wire [5:0] erase_end;
+	wire [2:0] base;
+
+	vt100 #(.COLS(COLS), .ROWS(ROWS)) dut(
+		.clk(clk),
+		.reset(reset),
+		.in_available(pos < len),
+		.in_data(stream[pos]),
+		.in_strobe(in_strobe),
+		.write_strobe(write_strobe),
+		.write_data(write_data),
+		.write_x(write_x),
+		.write_y(write_y),
+		.erase_strobe(erase_strobe),
+		.erase_rows(erase_rows),
+		.erase_start(erase_start),
+		.erase_end(erase_end),
+		.base(base)
+	);
+
+	textbuffer tb(
+		.clk(clk),
+		.lcd_x(8'h00),
+		.lcd_y(3'h0),
+		.write_strobe(write_strobe),
+		.in(write_data),
+		.write_x(write_x),
+		.write_y(write_y),
+		.erase_strobe(erase_strobe),
+		.erase_rows(erase_rows),
+		.erase_start(erase_start),
+		.erase_end(erase_end),
+		.base(base)
+	);
+
+	always @(posedge clk)
+		if (in_strobe)
+			pos <= pos + 1;
+
+	// a cell as the display would see it
+	function [8:0] cell;
+		input integer x;
+		input integer y;
+		reg [2:0] row;
+	begin
+		row = y + base;
+		cell = tb.valid[row][x] ? tb.text[{ row, x[5:0] }] : " ";
+	end
+	endfunction
+
+	integer x;
+	integer y;
+	integer errors;
+	integer cycles;
+
+	initial begin
+		$readmemh("vt100_tb.hex", stream);
+		$readmemh("vt100_tb_screen.hex", expected);
+
+		len = 0;
+		while (len < 4096 && stream[len] !== 8'hxx)
+			len = len + 1;
+		pos = 0;
+
+		repeat(4) @(posedge clk);
+		reset <= 0;
+
+		// every byte should take at most three clocks
+		cycles = 0;
+		while (pos < len) begin
+			@(posedge clk);
+			cycles = cycles + 1;
+		end
+		repeat(8) @(posedge clk);
+
+		errors = 0;
+		for(y = 0 ; y < ROWS ; y = y + 1) begin
+			for(x = 0 ; x < COLS ; x = x + 1) begin
+				if (cell(x, y) !== expected[y*COLS + x]) begin
+					$display("row %0d col %0d: %h != %h",
+						y, x, cell(x, y), expected[y*COLS + x]);
+					errors = errors + 1;
+				end
+			end
+		end
+
+		$display("%0d bytes in %0d clocks", len, cycles);
+
+		if (cycles > len * 3) begin
+			$display("too slow");
+			errors = errors + 1;
+		end
+
+		if (errors != 0) begin
+			$display("FAIL: %0d errors", errors);
+			$finish_and_return(1);
+		end
+
+		$display("PASS");
+		$finish;
+	end
+endmodule